@@ -0,0 +1,135 @@
+#include "bitmap.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace app {
+
+namespace {
+
+    uint64_t reverseBits(uint64_t v) {
+        v = ((v >> 1U) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1U);
+        v = ((v >> 2U) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2U);
+        v = ((v >> 4U) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4U);
+        v = ((v >> 8U) & 0x00FF00FF00FF00FFULL) | ((v & 0x00FF00FF00FF00FFULL) << 8U);
+        v = ((v >> 16U) & 0x0000FFFF0000FFFFULL) | ((v & 0x0000FFFF0000FFFFULL) << 16U);
+        return (v >> 32U) | (v << 32U);
+    }
+
+    // in-place transposition of a 64x64 bit block (row i = word i), by swapping ever smaller sub-blocks
+    void transpose64(std::array<uint64_t, 64>& block) {
+        uint64_t mask = 0x00000000FFFFFFFFULL;
+        for (unsigned j = 32; j != 0; j >>= 1U, mask ^= (mask << j)) {
+            for (unsigned k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+                const uint64_t t = ((block[k] >> j) ^ block[k | j]) & mask;
+                block[k] ^= t << j;
+                block[k | j] ^= t;
+            }
+        }
+    }
+
+} // anonymous namespace
+
+Bitmap::Bitmap(Size size) : m_size{size}, m_stride{(std::max(0, size.w) + 63) / 64} {
+    words.resize(static_cast<size_t>(m_stride) * std::max(0, size.h));
+}
+
+Bitmap Bitmap::fromCells(const std::vector<Point>& cells) {
+    Size size;
+    for (const Point& p : cells) {
+        size = {std::max(size.w, p.x + 1), std::max(size.h, p.y + 1)};
+    }
+    Bitmap bitmap{size};
+    for (const Point& p : cells) {
+        bitmap.set(p.x, p.y, true);
+    }
+    return bitmap;
+}
+
+void Bitmap::set(int x, int y, bool alive) {
+    const uint64_t bit = uint64_t{1} << static_cast<unsigned>(x % 64);
+    uint64_t& word = words[y * m_stride + x / 64];
+    word = alive ? word | bit : word & ~bit;
+}
+
+uint8_t Bitmap::byteAt(int x, int y) const {
+    const uint64_t* r = &words[y * m_stride];
+    const auto shift = static_cast<unsigned>(x % 64);
+    uint64_t bits = r[x / 64] >> shift;
+    if (shift > 56 && x / 64 + 1 < m_stride) {
+        bits |= r[x / 64 + 1] << (64 - shift);
+    }
+    return static_cast<uint8_t>(bits);
+}
+
+Bitmap Bitmap::transformed(Transform transform) const {
+    // flip first, then rotate clockwise
+    const auto value = static_cast<uint8_t>(transform);
+    const Bitmap flipped = (value & 4U) != 0 ? flippedHorizontally() : *this;
+    switch (value & 3U) {
+        case 1: return flipped.transposed().flippedHorizontally();
+        case 2: return flipped.flippedHorizontally().flippedVertically();
+        case 3: return flipped.transposed().flippedVertically();
+        default: return flipped;
+    }
+}
+
+Bitmap Bitmap::flippedHorizontally() const {
+    // reversing the words and their bits mirrors the whole padded row, which is then shifted back by the padding
+    Bitmap result{m_size};
+    const auto padding = static_cast<unsigned>(m_stride * 64 - m_size.w);
+    for (int y = 0; y < m_size.h; y++) {
+        const std::span<const uint64_t> source = row(y);
+        const std::span<uint64_t> target = result.row(y);
+        for (int i = 0; i < m_stride; i++) {
+            target[m_stride - 1 - i] = reverseBits(source[i]);
+        }
+        if (padding != 0) {
+            for (int i = 0; i < m_stride; i++) {
+                target[i] = (target[i] >> padding) | (i + 1 < m_stride ? target[i + 1] << (64 - padding) : 0);
+            }
+        }
+    }
+    return result;
+}
+
+Bitmap Bitmap::flippedVertically() const {
+    Bitmap result{m_size};
+    for (int y = 0; y < m_size.h; y++) {
+        std::copy(row(y).begin(), row(y).end(), result.row(m_size.h - 1 - y).begin());
+    }
+    return result;
+}
+
+Bitmap Bitmap::transposed() const {
+    // 64x64 blocks are transposed a word at a time
+    Bitmap result{{m_size.h, m_size.w}};
+    std::array<uint64_t, 64> block{};
+    for (int by = 0; by < result.m_stride; by++) {
+        for (int bx = 0; bx < m_stride; bx++) {
+            for (int i = 0; i < 64; i++) {
+                block[i] = by * 64 + i < m_size.h ? words[(by * 64 + i) * m_stride + bx] : 0;
+            }
+            transpose64(block);
+            for (int i = 0; i < 64 && bx * 64 + i < m_size.w; i++) {
+                result.words[(bx * 64 + i) * result.m_stride + by] = block[i];
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<Point> Bitmap::aliveCells() const {
+    std::vector<Point> cells;
+    for (int y = 0; y < m_size.h; y++) {
+        for (int i = 0; i < m_stride; i++) {
+            for (uint64_t word = words[y * m_stride + i]; word != 0; word &= word - 1) {
+                cells.push_back({i * 64 + std::countr_zero(word), y});
+            }
+        }
+    }
+    return cells;
+}
+
+}  // namespace app
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "primitives.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace app {
+
+// Packed 1-bit-per-cell image: each row is a sequence of 64-bit words, bit x % 64 of word x / 64 being cell x
+class Bitmap {
+public:
+    Bitmap() = default;
+    explicit Bitmap(Size size);
+
+    // smallest bitmap starting at (0, 0) which contains all the cells
+    static Bitmap fromCells(const std::vector<Point>& cells);
+
+    [[nodiscard]] Size size() const { return m_size; }
+    [[nodiscard]] int stride() const { return m_stride; }
+    [[nodiscard]] bool empty() const { return m_size.w <= 0 || m_size.h <= 0; }
+
+    [[nodiscard]] bool get(int x, int y) const { return ((words[y * m_stride + x / 64] >> (x % 64)) & 1U) != 0; }
+    void set(int x, int y, bool alive);
+
+    [[nodiscard]] std::span<const uint64_t> row(int y) const { return {&words[y * m_stride], static_cast<size_t>(m_stride)}; }
+    [[nodiscard]] std::span<uint64_t> row(int y) { return {&words[y * m_stride], static_cast<size_t>(m_stride)}; }
+
+    // 8 cells starting at x (cells past the end of the row are 0)
+    [[nodiscard]] uint8_t byteAt(int x, int y) const;
+
+    [[nodiscard]] Bitmap transformed(Transform transform) const;
+    [[nodiscard]] std::vector<Point> aliveCells() const;
+
+private:
+    Size m_size;
+    int m_stride = 0;
+    std::vector<uint64_t> words;
+
+    [[nodiscard]] Bitmap flippedHorizontally() const;
+    [[nodiscard]] Bitmap flippedVertically() const;
+    [[nodiscard]] Bitmap transposed() const;
+};
+
+}  // namespace app
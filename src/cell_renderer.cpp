@@ -0,0 +1,186 @@
+#include "cell_renderer.h"
+
+#include "colors.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// (MSVC doesn't define __SSE2__, SSE2 is implied by x64 or requested with /arch:SSE2 on x86)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CELL_RENDERER_SSE2
+#endif
+
+#if defined(__AVX2__) || defined(CELL_RENDERER_SSE2)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace app {
+
+namespace {
+
+    // rows this close to each other are sent together rather than locking the texture once more
+    constexpr int mergedRowsGap = 16;
+
+    constexpr uint32_t argb(SDL_Color color) {
+        return (uint32_t{color.a} << 24U) | (uint32_t{color.r} << 16U) | (uint32_t{color.g} << 8U) | color.b;
+    }
+
+    constexpr uint32_t alivePixel = argb(Color::AliveCell);
+    constexpr uint32_t deadPixel = argb(Color::DeadCell);
+
+    // Pixels of the cells [x, x + count) of a bitmap row, 8 at a time: each lane of a vector tests its bit of the byte
+    // of cells, and the resulting mask picks the alive or the dead pixel.
+    void expandRow(const Bitmap& cells, int x, int y, int count, uint32_t* out) {
+        int i = 0;
+#if defined(__AVX2__)
+        const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        const __m256i dead = _mm256_set1_epi32(static_cast<int>(deadPixel));
+        const __m256i flip = _mm256_set1_epi32(static_cast<int>(alivePixel ^ deadPixel));
+        for (; i + 8 <= count; i += 8) {
+            const __m256i byte = _mm256_set1_epi32(cells.byteAt(x + i, y));
+            const __m256i alive = _mm256_cmpeq_epi32(_mm256_and_si256(byte, bits), bits);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_xor_si256(dead, _mm256_and_si256(alive, flip)));
+        }
+#elif defined(CELL_RENDERER_SSE2)
+        const __m128i lowBits = _mm_setr_epi32(1, 2, 4, 8);
+        const __m128i highBits = _mm_setr_epi32(16, 32, 64, 128);
+        const __m128i dead = _mm_set1_epi32(static_cast<int>(deadPixel));
+        const __m128i flip = _mm_set1_epi32(static_cast<int>(alivePixel ^ deadPixel));
+        for (; i + 8 <= count; i += 8) {
+            const __m128i byte = _mm_set1_epi32(cells.byteAt(x + i, y));
+            const __m128i low = _mm_cmpeq_epi32(_mm_and_si128(byte, lowBits), lowBits);
+            const __m128i high = _mm_cmpeq_epi32(_mm_and_si128(byte, highBits), highBits);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_xor_si128(dead, _mm_and_si128(low, flip)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_xor_si128(dead, _mm_and_si128(high, flip)));
+        }
+#elif defined(__ARM_NEON)
+        const uint32x4_t lowBits = {1, 2, 4, 8};
+        const uint32x4_t highBits = {16, 32, 64, 128};
+        const uint32x4_t dead = vdupq_n_u32(deadPixel);
+        const uint32x4_t alive = vdupq_n_u32(alivePixel);
+        for (; i + 8 <= count; i += 8) {
+            const uint32x4_t byte = vdupq_n_u32(cells.byteAt(x + i, y));
+            vst1q_u32(out + i, vbslq_u32(vtstq_u32(byte, lowBits), alive, dead));
+            vst1q_u32(out + i + 4, vbslq_u32(vtstq_u32(byte, highBits), alive, dead));
+        }
+#endif
+        for (; i < count; i++) {
+            out[i] = cells.get(x + i, y) ? alivePixel : deadPixel;
+        }
+    }
+
+} // anonymous namespace
+
+std::vector<uint32_t> aliveShades(int cells) {
+    // the square root keeps the groups with a few alive cells visible
+    std::vector<uint32_t> shades(cells + 1);
+    for (int alive = 0; alive <= cells; alive++) {
+        const double fraction = std::sqrt(static_cast<double>(alive) / cells);
+        const auto mix = [fraction](uint8_t dead, uint8_t live) {
+            return static_cast<uint8_t>(std::lround(dead + (live - dead) * fraction));
+        };
+        shades[alive] = argb({mix(Color::DeadCell.r, Color::AliveCell.r), mix(Color::DeadCell.g, Color::AliveCell.g),
+                              mix(Color::DeadCell.b, Color::AliveCell.b), mix(Color::DeadCell.a, Color::AliveCell.a)});
+    }
+    return shades;
+}
+
+CellRenderer::CellRenderer(const sdl::Renderer& renderer, Size size, int densityLevel) :
+    m_size{size},
+    texture{SDL_CreateTexture(renderer.getRaw(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, size.w, size.h)},
+    pixels(static_cast<size_t>(size.w) * size.h, deadPixel),
+    shades{aliveShades(1 << (2 * densityLevel))},
+    dirtyRows(size.h, 1),
+    dirty{true} {
+}
+
+void CellRenderer::redraw(const Bitmap& cells, Point origin, std::span<const Rect> occupied) {
+    // cleared once, then only the occupied parts are expanded: the cost follows the live cells rather than the area
+    std::fill(pixels.begin(), pixels.end(), deadPixel);
+    const Vector offset{origin.x, origin.y};
+    for (const Rect& part : occupied) {
+        const Rect target = intersect({part.position + offset, part.size}, intersect({origin, cells.size()}, {{0, 0}, m_size}));
+        for (int y = target.position.y; y < target.position.y + target.size.h; y++) {
+            uint32_t* row = &pixels[static_cast<size_t>(y) * m_size.w];
+            expandRow(cells, target.position.x - origin.x, y - origin.y, target.size.w, row + target.position.x);
+        }
+    }
+
+    std::fill(dirtyRows.begin(), dirtyRows.end(), 1);
+    dirty = true;
+}
+
+void CellRenderer::set(Point p, bool alive) {
+    if (p.x < 0 || p.y < 0 || p.x >= m_size.w || p.y >= m_size.h) {
+        return;
+    }
+    pixels[static_cast<size_t>(p.y) * m_size.w + p.x] = alive ? alivePixel : deadPixel;
+    dirtyRows[p.y] = 1;
+    dirty = true;
+}
+
+void CellRenderer::redraw(const DensityLevel& density, Point origin, std::span<const Rect> occupied) {
+    std::fill(pixels.begin(), pixels.end(), deadPixel);
+    const Vector offset{origin.x, origin.y};
+    for (const Rect& part : occupied) {
+        const Rect target = intersect({part.position + offset, part.size}, intersect({origin, density.size}, {{0, 0}, m_size}));
+        for (int y = target.position.y; y < target.position.y + target.size.h; y++) {
+            uint32_t* row = &pixels[static_cast<size_t>(y) * m_size.w];
+            for (int x = target.position.x; x < target.position.x + target.size.w; x++) {
+                row[x] = shades[density.get(x - origin.x, y - origin.y)];
+            }
+        }
+    }
+
+    std::fill(dirtyRows.begin(), dirtyRows.end(), 1);
+    dirty = true;
+}
+
+void CellRenderer::shade(Point p, int alive) {
+    if (p.x < 0 || p.y < 0 || p.x >= m_size.w || p.y >= m_size.h) {
+        return;
+    }
+    pixels[static_cast<size_t>(p.y) * m_size.w + p.x] = shades[alive];
+    dirtyRows[p.y] = 1;
+    dirty = true;
+}
+
+void CellRenderer::render(const sdl::Renderer& renderer) {
+    if (dirty) {
+        upload();
+    }
+    renderer.copy(texture.getRaw(), nullptr, nullptr);
+}
+
+void CellRenderer::upload() {
+    for (int y = 0; y < m_size.h;) {
+        if (dirtyRows[y] == 0) {
+            y++;
+            continue;
+        }
+
+        // a run of dirty rows, with the clean rows between them if they're close
+        int end = y + 1;
+        for (int next = end; next < m_size.h && next - end < mergedRowsGap; next++) {
+            if (dirtyRows[next] != 0) {
+                end = next + 1;
+            }
+        }
+
+        const SDL_Rect rect{0, y, m_size.w, end - y};
+        int pitch = 0;
+        auto* locked = static_cast<uint8_t*>(texture.lock(&rect, &pitch));
+        for (int row = y; row < end; row++) {
+            std::memcpy(locked + static_cast<size_t>(row - y) * pitch, &pixels[static_cast<size_t>(row) * m_size.w], m_size.w * sizeof(uint32_t));
+            dirtyRows[row] = 0;
+        }
+        texture.unlock();
+        y = end;
+    }
+    dirty = false;
+}
+
+}  // namespace app
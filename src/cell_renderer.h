@@ -0,0 +1,49 @@
+#pragma once
+
+#include "bitmap.h"
+#include "primitives.h"
+#include "sdl_wrappers.h"
+#include "simulation.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace app {
+
+// ARGB8888 shades of a group of cells by how many of them are alive, from 0 to cells
+[[nodiscard]] std::vector<uint32_t> aliveShades(int cells);
+
+// Image of the visible cells, one pixel per cell, in a streaming texture. The pixels are written directly in ARGB8888:
+// all of them for a full redraw, one at a time for the cells which changed. Only the modified rows go to the texture.
+// Zoomed out, a pixel is a block of the given density level instead, shaded by its fraction of alive cells.
+class CellRenderer {
+public:
+    CellRenderer(const sdl::Renderer& renderer, Size size, int densityLevel = 0);
+
+    [[nodiscard]] Size size() const { return m_size; }
+
+    // the alive cells of the bitmap with its top left corner at origin, everything else dead; only the given parts of
+    // the bitmap have live cells
+    void redraw(const Bitmap& cells, Point origin, std::span<const Rect> occupied);
+    void set(Point p, bool alive);
+    // zoomed out: the same with the blocks of the density level, for a block with this many alive cells
+    void redraw(const DensityLevel& density, Point origin, std::span<const Rect> occupied);
+    void shade(Point p, int alive);
+
+    // stretched over the whole window
+    void render(const sdl::Renderer& renderer);
+
+private:
+    Size m_size;
+    sdl::Texture texture;
+    // (the content of a locked texture is undefined, the rows sent to it are copied from here)
+    std::vector<uint32_t> pixels;
+    std::vector<uint32_t> shades; // by number of alive cells in a block
+    std::vector<uint8_t> dirtyRows;
+    bool dirty = false;
+
+    void upload();
+};
+
+}  // namespace app
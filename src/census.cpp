@@ -0,0 +1,254 @@
+#include "census.h"
+#include "random.h"
+
+#include <algorithm>
+#include <future>
+#include <numeric>
+#include <thread>
+
+namespace app {
+
+namespace {
+
+    // oscillators and spaceships are registered with all their phases
+    constexpr int maxLearntPeriod = 30;
+    constexpr int maxLearntSize = 64;
+
+    struct Cluster {
+        std::vector<Point> cells;
+        bool touchesTop = false;
+        bool touchesBottom = false;
+    };
+
+    class UnionFind {
+    public:
+        explicit UnionFind(size_t size) : parents(size) {
+            std::iota(parents.begin(), parents.end(), 0);
+        }
+
+        int find(int i) {
+            while (parents[i] != i) {
+                parents[i] = parents[parents[i]];
+                i = parents[i];
+            }
+            return i;
+        }
+
+        void unite(int a, int b) {
+            parents[find(a)] = find(b);
+        }
+
+    private:
+        std::vector<int> parents;
+    };
+
+    // connected clusters of a horizontal band of the world
+    std::vector<Cluster> findClusters(const Simulation& simulation, Rect band) {
+        const std::vector<Point> cells = simulation.aliveCells(band);
+        const int width = simulation.size().w;
+        robin_hood::unordered_map<int, int> ids;
+        ids.reserve(cells.size());
+        for (int i = 0; i < static_cast<int>(cells.size()); i++) {
+            ids[cells[i].y * width + cells[i].x] = i;
+        }
+
+        UnionFind unionFind{cells.size()};
+        for (int i = 0; i < static_cast<int>(cells.size()); i++) {
+            const Point p = cells[i];
+            for (int dy = -Census::clusterDistance; dy <= Census::clusterDistance; dy++) {
+                for (int dx = -Census::clusterDistance; dx <= Census::clusterDistance; dx++) {
+                    // every pair is seen twice, half of the neighbourhood is enough
+                    if (dy > 0 || (dy == 0 && dx >= 0)) {
+                        continue;
+                    }
+                    if (const auto found = ids.find((p.y + dy) * width + p.x + dx); found != ids.end()) {
+                        unionFind.unite(i, found->second);
+                    }
+                }
+            }
+        }
+
+        robin_hood::unordered_map<int, int> clusterIds;
+        std::vector<Cluster> clusters;
+        const int bottom = band.position.y + band.size.h - 1;
+        for (int i = 0; i < static_cast<int>(cells.size()); i++) {
+            const auto [it, inserted] = clusterIds.try_emplace(unionFind.find(i), static_cast<int>(clusters.size()));
+            if (inserted) {
+                clusters.emplace_back();
+            }
+            Cluster& cluster = clusters[it->second];
+            cluster.cells.push_back(cells[i]);
+            cluster.touchesTop |= cells[i].y < band.position.y + Census::clusterDistance;
+            cluster.touchesBottom |= cells[i].y > bottom - Census::clusterDistance;
+        }
+        return clusters;
+    }
+
+    // merges the clusters which span several bands
+    std::vector<Cluster> mergeBands(std::vector<std::vector<Cluster>> bands, int width) {
+        std::vector<Cluster> result;
+        std::vector<Cluster> edges;
+        for (auto& band : bands) {
+            for (auto& cluster : band) {
+                (cluster.touchesTop || cluster.touchesBottom ? edges : result).push_back(std::move(cluster));
+            }
+        }
+
+        robin_hood::unordered_map<int, int> owners;
+        for (int i = 0; i < static_cast<int>(edges.size()); i++) {
+            for (const Point& p : edges[i].cells) {
+                owners[p.y * width + p.x] = i;
+            }
+        }
+        UnionFind unionFind{edges.size()};
+        for (int i = 0; i < static_cast<int>(edges.size()); i++) {
+            if (!edges[i].touchesBottom) {
+                continue;
+            }
+            for (const Point& p : edges[i].cells) {
+                for (int dy = 1; dy <= Census::clusterDistance; dy++) {
+                    for (int dx = -Census::clusterDistance; dx <= Census::clusterDistance; dx++) {
+                        if (const auto found = owners.find((p.y + dy) * width + p.x + dx); found != owners.end()) {
+                            unionFind.unite(i, found->second);
+                        }
+                    }
+                }
+            }
+        }
+
+        robin_hood::unordered_map<int, int> merged;
+        for (int i = 0; i < static_cast<int>(edges.size()); i++) {
+            const auto [it, inserted] = merged.try_emplace(unionFind.find(i), static_cast<int>(result.size()));
+            if (inserted) {
+                result.emplace_back();
+            }
+            auto& cells = result[it->second].cells;
+            cells.insert(cells.end(), edges[i].cells.begin(), edges[i].cells.end());
+        }
+        return result;
+    }
+
+    Rect bounds(const std::vector<Point>& cells) {
+        Point min = cells.front();
+        Point max = cells.front();
+        for (const Point& p : cells) {
+            min = {std::min(min.x, p.x), std::min(min.y, p.y)};
+            max = {std::max(max.x, p.x), std::max(max.y, p.y)};
+        }
+        return {min, {max.x - min.x + 1, max.y - min.y + 1}};
+    }
+
+} // anonymous namespace
+
+Census::Census(const std::vector<Pattern>& library) {
+    for (const Pattern& pattern : library) {
+        learn(pattern);
+    }
+}
+
+void Census::learn(const Pattern& pattern) {
+    if (pattern.aliveCells().empty() || pattern.size().w > maxLearntSize || pattern.size().h > maxLearntSize) {
+        return;
+    }
+
+    // run the pattern on its own to find out whether it comes back to its original shape
+    const uint64_t original = canonicalHash(pattern.aliveCells());
+    std::vector<uint64_t> phases{original};
+    const int margin = maxLearntPeriod + 4;
+    Simulation simulation{{pattern.size().w + 2 * margin, pattern.size().h + 2 * margin}, pattern};
+    for (int generation = 1; generation <= maxLearntPeriod; generation++) {
+        simulation.nextStep();
+        const std::vector<Point> cells = simulation.aliveCells({{0, 0}, simulation.size()});
+        if (cells.empty()) {
+            break;
+        }
+        const uint64_t phase = canonicalHash(cells);
+        if (phase == original) {
+            // periodic: every phase is a legitimate shape of the object
+            for (const uint64_t hash : phases) {
+                knownObjects.try_emplace(hash, pattern.name());
+            }
+            return;
+        }
+        phases.push_back(phase);
+    }
+    knownObjects.try_emplace(original, pattern.name());
+}
+
+uint64_t Census::canonicalHash(std::vector<Point> cells) {
+    if (cells.empty()) {
+        return 0;
+    }
+
+    // the canonical shape is the smallest of the 8 orientations once sorted
+    const Rect box = bounds(cells);
+    for (Point& p : cells) {
+        p = p - Vector{box.position.x, box.position.y};
+    }
+    const auto less = [](Point a, Point b) { return a.y != b.y ? a.y < b.y : a.x < b.x; };
+    std::vector<Point> best;
+    Size bestSize;
+    std::vector<Point> oriented(cells.size());
+    for (int t = 0; t < transformCount; t++) {
+        const auto orientation = static_cast<Transform>(t);
+        std::transform(cells.begin(), cells.end(), oriented.begin(), [&](Point p) { return transform(p, box.size, orientation); });
+        std::sort(oriented.begin(), oriented.end(), less);
+        const Size size = transform(box.size, orientation);
+        if (best.empty() || std::tie(size.w, size.h) < std::tie(bestSize.w, bestSize.h)
+                || (size.w == bestSize.w && size.h == bestSize.h && std::lexicographical_compare(oriented.begin(), oriented.end(), best.begin(), best.end(), less))) {
+            best = oriented;
+            bestSize = size;
+        }
+    }
+
+    uint64_t hash = splitMix64((static_cast<uint64_t>(bestSize.w) << 32U) | static_cast<uint32_t>(bestSize.h));
+    for (const Point& p : best) {
+        hash = splitMix64(hash ^ ((static_cast<uint64_t>(p.x) << 32U) | static_cast<uint32_t>(p.y)));
+    }
+    return hash;
+}
+
+std::vector<CensusEntry> Census::run(const Simulation& simulation) const {
+    // the world is cut in bands of whole tiles which are scanned in parallel
+    const int tileRows = simulation.tiles().h;
+    const int nbBands = std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, tileRows);
+    std::vector<std::future<std::vector<Cluster>>> futures;
+    for (int band = 0; band < nbBands; band++) {
+        const int top = band * tileRows / nbBands * Simulation::tileSize;
+        const int bottom = std::min(simulation.size().h, (band + 1) * tileRows / nbBands * Simulation::tileSize);
+        const Rect rect{{0, top}, {simulation.size().w, bottom - top}};
+        futures.push_back(std::async(std::launch::async, [&simulation, rect] { return findClusters(simulation, rect); }));
+    }
+    std::vector<std::vector<Cluster>> bands;
+    bands.reserve(futures.size());
+    for (auto& future : futures) {
+        bands.push_back(future.get());
+    }
+    const std::vector<Cluster> clusters = mergeBands(std::move(bands), simulation.size().w);
+
+    robin_hood::unordered_map<uint64_t, CensusEntry> histogram;
+    for (const Cluster& cluster : clusters) {
+        const uint64_t hash = canonicalHash(cluster.cells);
+        auto [it, inserted] = histogram.try_emplace(hash);
+        CensusEntry& entry = it->second;
+        if (inserted) {
+            const auto known = knownObjects.find(hash);
+            entry.name = known != knownObjects.end() ? known->second : "";
+            entry.hash = hash;
+            entry.size = bounds(cluster.cells).size;
+        }
+        entry.count++;
+    }
+
+    std::vector<CensusEntry> entries;
+    entries.reserve(histogram.size());
+    for (auto& [hash, entry] : histogram) {
+        entries.push_back(std::move(entry));
+    }
+    std::sort(entries.begin(), entries.end(), [](const CensusEntry& a, const CensusEntry& b) {
+        return a.count != b.count ? a.count > b.count : a.hash < b.hash;
+    });
+    return entries;
+}
+
+}  // namespace app
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "../deps/robin_hood.h"
+
+#include "pattern.h"
+#include "primitives.h"
+#include "simulation.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace app {
+
+struct CensusEntry {
+    std::string name; // empty for unknown objects
+    uint64_t hash{};  // hash of the canonical shape, the same for the 8 orientations of an object
+    Size size{};
+    int count{};
+};
+
+// Finds the objects of a world and sorts them into known and unknown shapes
+class Census {
+public:
+    // cells at most this far apart (in both directions) belong to the same object, so that oscillators like the toad stay in one piece
+    static constexpr int clusterDistance = 2;
+
+    explicit Census(const std::vector<Pattern>& library);
+
+    // histogram of the objects in the world, most frequent first
+    [[nodiscard]] std::vector<CensusEntry> run(const Simulation& simulation) const;
+
+    [[nodiscard]] static uint64_t canonicalHash(std::vector<Point> cells);
+
+private:
+    robin_hood::unordered_map<uint64_t, std::string> knownObjects;
+
+    void learn(const Pattern& pattern);
+};
+
+}  // namespace app
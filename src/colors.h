@@ -7,4 +7,6 @@ namespace app::Color {
     constexpr static SDL_Color AliveCell = {52, 119, 235, SDL_ALPHA_OPAQUE};
     constexpr static SDL_Color PatternOverlay = {220, 220, 220, 150};
     constexpr static SDL_Color PatternCell = {52, 119, 235, SDL_ALPHA_OPAQUE};
+    constexpr static SDL_Color Selection = {235, 119, 52, SDL_ALPHA_OPAQUE};
+    constexpr static SDL_Color Difference = {235, 52, 80, SDL_ALPHA_OPAQUE};
 } // namespace app::Color
@@ -7,7 +7,9 @@
 #include "pattern.h"
 
 #include <algorithm>
+#include <bit>
 #include <filesystem>
+#include <functional>
 #include <fmt/format.h>
 
 namespace app {
@@ -16,19 +18,24 @@ namespace {
 
     constexpr Size simSize{11264, 6336};
     constexpr double minFps = 45.;
+    // generations computed ahead of a paused world
+    constexpr int lookAheadDepth = 8;
+    constexpr double soupDensity = 0.5;
+    constexpr size_t historyBudget = size_t{256} << 20U;
+    constexpr size_t populationLogSize = 1024;
+    // a replayed toggle (decoding, parity set) costs about as much as this many cells of a full redraw
+    constexpr size_t toggleRenderCost = 4;
+    // below 1, zoomed out: 2, 4, 8 then 16 cells per pixel
+    constexpr int minCellSize = -3;
 
     bool isMouseEvent(const SDL_Event& e) {
         return e.type == SDL_MOUSEWHEEL || e.type == SDL_MOUSEBUTTONDOWN || e.type == SDL_MOUSEBUTTONUP || e.type == SDL_MOUSEMOTION;
     }
 
-    sdl::Texture createRenderTexture(const sdl::Renderer& renderer, Coordinates coords) {
-        sdl::Texture texture{SDL_CreateTexture(renderer.getRaw(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, coords.grid().w, coords.grid().h)};
-        texture.setBlendMode(SDL_BLENDMODE_BLEND);
-        return texture;
-    }
-
     sdl::Texture createGridTexture(const sdl::Renderer& renderer, Coordinates coords) {
-        const Size textureSize = {coords.window().w - coords.window().w % coords.gridCellSize(), coords.window().h - coords.window().h % coords.gridCellSize()};
+        // (zoomed out, the grid isn't shown)
+        const int cellSize = std::max(1, coords.gridCellSize());
+        const Size textureSize = {coords.window().w - coords.window().w % cellSize, coords.window().h - coords.window().h % cellSize};
         const Size nbLines = coords.grid() + 1;
 
         sdl::Texture texture{SDL_CreateTexture(renderer.getRaw(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, textureSize.w, textureSize.h)};
@@ -39,14 +46,14 @@ namespace {
         renderer.setDrawColor(Color::Grid);
         for (int y = 1; y <= nbLines.h; ++y) {
             renderer.drawLine(
-               {0, y * coords.gridCellSize()},
-               {nbLines.w * coords.gridCellSize(), y * coords.gridCellSize()}
+               {0, y * cellSize},
+               {nbLines.w * cellSize, y * cellSize}
             );
         }
         for (int x = 1; x <= nbLines.w; ++x) {
             renderer.drawLine(
-               {x * coords.gridCellSize(), 0},
-               {x * coords.gridCellSize(), nbLines.h * coords.gridCellSize()});
+               {x * cellSize, 0},
+               {x * cellSize, nbLines.h * cellSize});
         }
 
         renderer.setTarget(nullptr);
@@ -72,6 +79,14 @@ namespace {
         return patterns;
     }
 
+    std::vector<Pattern> censusLibrary() {
+        std::vector<Pattern> patterns = Patterns::commonObjects();
+        for (Pattern& pattern : Patterns::defaultPatterns()) {
+            patterns.push_back(std::move(pattern));
+        }
+        return patterns;
+    }
+
 } // anonymous namespace
 
 Game::Game(sdl::Window* window) :
@@ -82,11 +97,17 @@ Game::Game(sdl::Window* window) :
     renderer{SDL_CreateRenderer(window->getRaw(), -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC)},
     coordinates(simSize, renderer.getOutputSize(), cellSize),
     gridTexture{createGridTexture(renderer, coordinates)},
-    renderTexture{createRenderTexture(renderer, coordinates)},
+    cellRenderer{renderer, coordinates.grid(), coordinates.densityLevel()},
+    populationLog{populationLogSize},
     simulation{std::make_unique<Simulation>(simSize, Patterns::acorn())},
+    minimap{renderer, simulation->tiles()},
+    history{historyBudget},
+    objectCensus{censusLibrary()},
     nuklearSdl{window->getRaw(), renderer.getRaw(), "assets/Cousine-Regular.ttf", 16},
-    bindings{&displayGrid, &updateSpeedPower, &paused, &cellSize, &selectedPattern, &modalGui, &step, &clear, &iteration},
+    bindings{&displayGrid, &autoPause, &lookAhead, &updateSpeedPower, &paused, &cellSize, &selectedPattern, &modalGui, &step, &stepBack, &clear, &randomFill, &census, &saveCheckpoint, &restoreCheckpoint, &compare, &iteration, &timeline, &timelineStart, &timelineEnd, &population, &visiblePopulation, &births, &deaths, &boundingBox, &period, &frozen, &differences, &differenceBounds, &minimap, &viewport},
     gui{&nuklearSdl.getContext(), loadAllPatterns(), bindings} {
+    simulation->addObserver(&populationLog);
+    subscribeRenderer();
     resetSimClock();
 }
 
@@ -107,7 +128,7 @@ void Game::handleEvents(std::span<SDL_Event> events, bool mouseOnGui) {
 
             case SDL_MOUSEWHEEL: {
                 if (!modalGui && event.wheel.y != 0) {
-                    cellSize = std::min(32, std::max(1, cellSize + (event.wheel.y > 0 ? 1 : -1)));
+                    cellSize = std::min(32, std::max(minCellSize, cellSize + (event.wheel.y > 0 ? 1 : -1)));
                 }
             } break;
 
@@ -123,10 +144,13 @@ void Game::handleEvents(std::span<SDL_Event> events, bool mouseOnGui) {
 
             case SDL_KEYDOWN: {
                 SDL_Scancode scancode = event.key.keysym.scancode;
+                const bool command = (event.key.keysym.mod & (KMOD_CTRL | KMOD_GUI)) != 0;
                 if (!modalGui && selectedPattern == nullptr && SDL_SCANCODE_SPACE == scancode) {
                     paused = !paused;
                 } else if (!modalGui && selectedPattern == nullptr && SDL_SCANCODE_RIGHT == scancode) {
                     step = true;
+                } else if (!modalGui && selectedPattern == nullptr && SDL_SCANCODE_LEFT == scancode) {
+                    stepBack = true;
                 } else if (!modalGui && selectedPattern == nullptr && SDL_SCANCODE_B == scancode) {
                     benchmark = true;
                 } else if (!modalGui && SDL_SCANCODE_G == scancode) {
@@ -135,8 +159,25 @@ void Game::handleEvents(std::span<SDL_Event> events, bool mouseOnGui) {
                     updateSpeedPower = std::min(10, updateSpeedPower + 1);
                 } else if (!modalGui && selectedPattern == nullptr && SDL_SCANCODE_DOWN == scancode) {
                     updateSpeedPower = std::max(0, updateSpeedPower - 1);
+                } else if (selectedPattern != nullptr && SDL_SCANCODE_R == scancode) {
+                    patternTransform = rotated(patternTransform);
+                } else if (selectedPattern != nullptr && SDL_SCANCODE_F == scancode) {
+                    patternTransform = flipped(patternTransform);
+                } else if (!modalGui && selectedPattern == nullptr && command && SDL_SCANCODE_C == scancode) {
+                    copySelection();
+                } else if (!modalGui && selectedPattern == nullptr && command && SDL_SCANCODE_X == scancode) {
+                    cutSelection();
+                } else if (!modalGui && selectedPattern == nullptr && command && SDL_SCANCODE_V == scancode) {
+                    paste();
+                } else if (!modalGui && selectedPattern == nullptr && (SDL_SCANCODE_DELETE == scancode || SDL_SCANCODE_BACKSPACE == scancode)) {
+                    clearSelection();
+                } else if (!modalGui && selectedPattern == nullptr && SDL_SCANCODE_R == scancode) {
+                    transformSelection(Transform::Rotate90);
+                } else if (!modalGui && selectedPattern == nullptr && SDL_SCANCODE_F == scancode) {
+                    transformSelection(Transform::Flip);
                 } else if (SDL_SCANCODE_ESCAPE == scancode) {
                     selectedPattern = nullptr;
+                    selection = {};
                     modalGui = false;
                 }
             } break;
@@ -145,7 +186,7 @@ void Game::handleEvents(std::span<SDL_Event> events, bool mouseOnGui) {
                 break;
         }
     }
-    SDL_GetMouseState(&mouse.x, &mouse.y);
+    const uint32_t buttons = SDL_GetMouseState(&mouse.x, &mouse.y);
 
     if (coordinates.gridCellSize() != cellSize) {
         if (cellSize < coordinates.gridCellSize() && cellSize < 4 && displayGrid == 1) {
@@ -159,9 +200,15 @@ void Game::handleEvents(std::span<SDL_Event> events, bool mouseOnGui) {
         }
         onCoordinatesChanged();
     }
-    if (!modalGui && selectedPattern == nullptr && left != right) {
+    if (!modalGui && selectedPattern == nullptr && left && (selecting || (SDL_GetModState() & KMOD_SHIFT) != 0)) {
+        // shift-drag selects a rectangle
+        selectTo(coordinates.windowToSim(mouse));
+    } else if (!modalGui && selectedPattern == nullptr && left != right) {
         mouseEdit(left ? CellState::ALIVE : CellState::DEAD);
     }
+    if ((buttons & SDL_BUTTON(SDL_BUTTON_LEFT)) == 0) {
+        selecting = false;
+    }
     if (selectedPattern != nullptr) {
         if (left) {
             placeSelectedPattern();
@@ -181,38 +228,127 @@ void Game::handleEvents(std::span<SDL_Event> events, bool mouseOnGui) {
 }
 
 void Game::update() {
+    // (before anything below moves the world, e.g. clearing it or restoring the checkpoint, which isn't the slider)
+    if (timeline != simulation->generation()) {
+        // the timeline slider was moved
+        paused = true;
+        seek(timeline);
+    }
+
     if (benchmark) {
         runBenchmark();
         return;
     }
 
+    if (census) {
+        runCensus();
+        return;
+    }
+
     if (clear) {
+        // (before the world goes away, or the keyframes would take a copy of it)
+        history.clear();
+        // (a runner follows a single world)
+        runner.reset();
         simulation = std::make_unique<Simulation>(simSize);
-        lastUpdates.clear();
+        simulation->addObserver(&populationLog);
+        populationLog.clear();
+        subscribeRenderer();
         iteration = 0;
+        periodic = false;
+        selection = {};
         clear = false;
         paused = true;
         forceFullRedraw = true;
     }
 
+    if (saveCheckpoint) {
+        checkpoint = simulation->snapshot();
+        saveCheckpoint = false;
+    }
+
+    if (restoreCheckpoint) {
+        if (checkpoint.valid()) {
+            simulation->restore(checkpoint);
+            iteration = static_cast<int>(checkpoint.generation());
+            periodic = false;
+            forceFullRedraw = true;
+        }
+        restoreCheckpoint = false;
+    }
+
+    if (compare) {
+        if (checkpoint.valid()) {
+            difference = simulation->diff(checkpoint);
+            differenceRevision = simulation->revision();
+            differenceGeneration = simulation->generation();
+        }
+        compare = false;
+    }
+
+    if (randomFill) {
+        // fills the visible part of the world
+        edit(EditCommand::fill(coordinates.visibleRegion(), soupDensity, soupSeed++));
+        randomFill = false;
+    }
+
+    if (stepBack) {
+        paused = true;
+        seek(simulation->generation() - 1);
+        stepBack = false;
+    }
+
     if (paused) {
         resetSimClock();
 
         if (step) {
-            simulation->nextStep();
-            forceFullRedraw = true;
-            iteration++;
+            // steps already in the history are replayed, the next ones may have been computed ahead
+            if (!seek(simulation->generation() + 1)) {
+                // (a step computed ahead is drawn from its delta like the running ones)
+                if (!runner || !runner->step(*simulation)) {
+                    simulation->nextStep();
+                }
+                history.record(*simulation);
+                iteration++;
+            }
             step = false;
         }
         return;
     }
 
+    if (simulation->frozen()) {
+        // nothing will change until the next edit
+        resetSimClock();
+        return;
+    }
+
     GameTime time = simClock.update();
     while (time.totalTime.count() >= nextSimUpdate) {
+#ifdef __EMSCRIPTEN__
+        // (no threads there: the generations are computed here)
         simulation->nextStep();
-        lastUpdates.push_back(simulation->updatedCells());
+#else
+        // the generations are computed by the runner, the ones it has ready are applied (with the edits in between)
+        if (runner && runner->applyEdits(*simulation)) {
+            forceFullRedraw = true;
+        }
+        if (!runner || !runner->step(*simulation)) {
+            // it's behind: no debt to catch up with once it has more
+            nextSimUpdate = time.totalTime.count();
+            break;
+        }
+#endif
+        history.record(*simulation);
         iteration++;
         nextSimUpdate += 1. / (1 << updateSpeedPower);
+        if (!periodic && simulation->period().has_value() && autoPause == 1) {
+            // the world just became periodic: nothing new will happen from now on
+            paused = true;
+        }
+        periodic = simulation->period().has_value();
+        if (paused || simulation->frozen()) {
+            break;
+        }
         if (minFpsClock.update().totalTime.count() > 1. / minFps) {
             // frame time is too large => throttle
             break;
@@ -220,6 +356,25 @@ void Game::update() {
     }
     minFpsClock = GameClock{};
 
+    if (runner) {
+        // the edits don't wait for the next generation
+        if (runner->applyEdits(*simulation)) {
+            forceFullRedraw = true;
+        }
+        // the runner can compute what will be due by the next frame, not more: edits would come after all of it
+        const double ahead = time.totalTime.count() + 1. / minFps - nextSimUpdate;
+        runner->allow(simulation->generation() + (ahead < 0 ? 0 : static_cast<int64_t>(ahead * (1 << updateSpeedPower)) + 1));
+    }
+}
+
+bool Game::seek(int64_t generation) {
+    if (!history.seek(*simulation, generation)) {
+        return false;
+    }
+    iteration = static_cast<int>(generation);
+    periodic = false;
+    forceFullRedraw = true;
+    return true;
 }
 
 void Game::runBenchmark() {
@@ -238,151 +393,362 @@ void Game::runBenchmark() {
         auto result = std::lround(pattern.second / gameTime.elapsedTime.count());
         message += fmt::format("{} = {} ups\n", pattern.first.name(), result);
     }
+    {
+        // the cost of an observer, called directly after each step
+        Simulation sim{simSize, patterns.front().first};
+        PopulationLog log{populationLogSize};
+        log.setProbe({{0, 0}, simSize});
+        GameClock benchClock;
+        for (int j = 0; j < patterns.front().second; j++) {
+            sim.nextStep(log);
+        }
+        const GameTime gameTime = benchClock.update();
+        message += fmt::format("{} + population log = {} ups\n", patterns.front().first.name(), std::lround(patterns.front().second / gameTime.elapsedTime.count()));
+    }
+    {
+        Simulation sim{simSize};
+        GameClock benchClock;
+        sim.fillRandom({{0, 0}, simSize}, soupDensity, 1);
+        const GameTime gameTime = benchClock.update();
+        message += fmt::format("Soup fill = {:.1f} ms\n", gameTime.elapsedTime.count() * 1000);
+    }
 
     window->showSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Benchmark results", message.c_str());
     benchmark = false;
     resetSimClock();
 }
 
+void Game::runCensus() {
+    constexpr size_t maxLines = 25;
+
+    const std::vector<CensusEntry> entries = objectCensus.run(*simulation);
+    int nbObjects = 0;
+    std::string message;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const CensusEntry& entry = entries[i];
+        nbObjects += entry.count;
+        if (i < maxLines) {
+            message += entry.name.empty()
+                ? fmt::format("unknown {}x{} ({:016x}) = {}\n", entry.size.w, entry.size.h, entry.hash, entry.count)
+                : fmt::format("{} = {}\n", entry.name, entry.count);
+        }
+    }
+    message = fmt::format("{} objects, {} distinct\n\n", nbObjects, entries.size()) + message;
+
+    window->showSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Census", message.c_str());
+    census = false;
+    resetSimClock();
+}
+
 void Game::resetSimClock() {
     simClock = GameClock{};
     nextSimUpdate = 1. / (1 << updateSpeedPower);
 }
 
 void Game::mouseEdit(CellState cellState) {
-    if (paused) {
-        const Point point = coordinates.windowToSim(mouse);
-        simulation->set(point.x, point.y, cellState);
-        forceFullRedraw = true;
+    // zoomed out, the window can show more than the world
+    const Point cell = coordinates.windowToSim(mouse);
+    if (!intersect({cell, {1, 1}}, {{0, 0}, simulation->size()}).empty()) {
+        edit(EditCommand::set(cell, cellState));
+    }
+}
+
+void Game::edit(const EditCommand& command) {
+    // a running world gets the edit from the runner, between two generations (a paused one is edited right away, the
+    // generations computed ahead of it are dropped)
+    if (!runner || paused || !runner->edit(*simulation, command)) {
+        if (runner) {
+            // (the edits it already has go first)
+            runner->stop(*simulation);
+        }
+        command.applyTo(*simulation);
+    }
+    forceFullRedraw = true;
+}
+
+void Game::selectTo(Point point) {
+    if (!selecting) {
+        selecting = true;
+        selectionStart = point;
+    }
+    const Point min{std::min(point.x, selectionStart.x), std::min(point.y, selectionStart.y)};
+    const Point max{std::max(point.x, selectionStart.x), std::max(point.y, selectionStart.y)};
+    selection = intersect({min, {max.x - min.x + 1, max.y - min.y + 1}}, {{0, 0}, simulation->size()});
+}
+
+void Game::copySelection() {
+    if (!selection.empty()) {
+        // (the size of the selection is kept, the paste is centered like the selection was)
+        clipboard = Pattern{"Clipboard", simulation->extract(selection)};
+        previewedPattern = nullptr;
+    }
+}
+
+void Game::clearSelection() {
+    if (!selection.empty()) {
+        edit(EditCommand::clear(selection));
+    }
+}
+
+void Game::cutSelection() {
+    // the cells copied are the ones cleared: the generations the runner computed ahead are dropped first and the edits
+    // it has are applied (a transform extracts the cells itself, when it's applied)
+    if (runner) {
+        runner->stop(*simulation);
+    }
+    copySelection();
+    clearSelection();
+}
+
+void Game::transformSelection(Transform t) {
+    if (!selection.empty()) {
+        // the transformed cells keep the center of the selection
+        edit(EditCommand::transformRegion(selection, t));
+        selection = intersect(transform(selection, t), {{0, 0}, simulation->size()});
+    }
+}
+
+void Game::paste() {
+    // the clipboard is then placed like any other pattern
+    if (!clipboard.aliveCells().empty()) {
+        selectedPattern = &clipboard;
+        patternTransform = Transform::Identity;
     }
 }
 
 void Game::onCoordinatesChanged() {
     coordinates = Coordinates{simSize, renderer.getOutputSize(), cellSize};
     gridTexture = createGridTexture(renderer, coordinates);
-    renderTexture = createRenderTexture(renderer, coordinates);
+    cellRenderer = CellRenderer{renderer, coordinates.grid(), coordinates.densityLevel()};
+    subscribeRenderer();
     forceFullRedraw = true;
 }
 
+void Game::subscribeRenderer() {
+    populationLog.setProbe(coordinates.visibleRegion());
+    simulation->setViewport(intersect(coordinates.visibleRegion(), {{0, 0}, simulation->size()}));
+    // the density pyramid is only maintained while zoomed out (then all of its levels, for the next zooms)
+    simulation->setDensityLevels(coordinates.densityLevel() > 0 ? 1 - minCellSize : 0);
+}
+
 void Game::placeSelectedPattern() {
     if (selectedPattern == nullptr) {
         return;
     }
 
-    Size s = selectedPattern->size() / 2;
-    const Vector offset = {s.w, s.h};
-    const Point origin = coordinates.windowToSim(mouse) - offset;
-    std::vector<SDL_Point> patternCells;
-    for (const Point& p : selectedPattern->aliveCells()) {
-        simulation->set(origin.x + p.x, origin.y + p.y, CellState::ALIVE);
-    }
-    forceFullRedraw = true;
+    const Point origin = coordinates.windowToSim(mouse) - selectedPatternOffset();
+    edit(EditCommand::place(selectedPattern->bitmap(), origin, patternTransform));
 
     selectedPattern = nullptr;
 }
 
+Vector Game::selectedPatternOffset() const {
+    const Size s = transform(selectedPattern->bitmap().size(), patternTransform) / 2;
+    return {s.w, s.h};
+}
+
 void Game::render() {
     renderCells();
     renderSelectedPattern();
+    renderDifference();
     renderGrid();
+    renderSelection();
 
     nuklearSdl.render();
     renderer.present();
 }
 
-void Game::renderSelectedPattern() const {
+void Game::renderSelectedPattern() {
     if (selectedPattern == nullptr && !modalGui) {
         return;
     }
 
-    renderer.setTarget(renderTexture.getRaw());
-
+    // (drawn over the window, the cells underneath stay as they are)
+    renderer.setDrawBlendMode(SDL_BLENDMODE_BLEND);
     renderer.setDrawColor(Color::PatternOverlay);
     renderer.fillRect(nullptr);
+    renderer.setDrawBlendMode(SDL_BLENDMODE_NONE);
 
-    if (selectedPattern != nullptr) {
-        Size s = selectedPattern->size() / 2;
-        const Vector offset = {s.w, s.h};
-        const Point origin = coordinates.windowToGrid(mouse) - offset;
-        std::vector<SDL_Point> patternCells;
-        for (const Point& p : selectedPattern->aliveCells()) {
-            patternCells.push_back({origin.x + p.x, origin.y + p.y});
+    if (selectedPattern == nullptr) {
+        return;
+    }
+    if (selectedPattern != previewedPattern || patternTransform != previewedTransform) {
+        patternPreview = selectedPattern->bitmap().transformed(patternTransform);
+        previewedPattern = selectedPattern;
+        previewedTransform = patternTransform;
+    }
+
+    // only the rows on screen, a rectangle per run of alive cells (zoomed out, the rows of a pixel are merged first)
+    const Point origin = coordinates.windowToSim(mouse) - selectedPatternOffset();
+    const Rect visible = intersect(coordinates.visibleRegion(), {origin, patternPreview.size()});
+    const int rowsPerPixel = 1 << coordinates.densityLevel();
+    std::vector<uint64_t> merged(patternPreview.stride());
+    std::vector<SDL_Rect> patternCells;
+    // (the groups of rows start on the pixels)
+    for (int y = (visible.position.y & -rowsPerPixel) - origin.y; y < visible.position.y + visible.size.h - origin.y; y += rowsPerPixel) {
+        const int first = std::max(y, 0);
+        const int last = std::min(y + rowsPerPixel, patternPreview.size().h);
+        std::fill(merged.begin(), merged.end(), 0);
+        for (int r = first; r < last; r++) {
+            const std::span<const uint64_t> row = patternPreview.row(r);
+            std::transform(merged.begin(), merged.end(), row.begin(), merged.begin(), std::bit_or{});
+        }
+
+        const int end = visible.position.x + visible.size.w - origin.x;
+        for (int x = visible.position.x - origin.x; x < end;) {
+            const uint64_t alive = merged[x / 64] >> (x % 64);
+            if (alive == 0) {
+                x = (x / 64 + 1) * 64;
+                continue;
+            }
+            x += std::countr_zero(alive);
+            int runEnd = x;
+            while (runEnd < end) {
+                const uint64_t dead = ~merged[runEnd / 64] >> (runEnd % 64);
+                if (dead != 0) {
+                    runEnd += std::countr_zero(dead);
+                    break;
+                }
+                runEnd = (runEnd / 64 + 1) * 64;
+            }
+            runEnd = std::min(runEnd, end);
+            if (x < runEnd) {
+                const Point topLeft = coordinates.simToWindow(origin + Vector{x, first});
+                const Point bottomRight = coordinates.simToWindow(origin + Vector{runEnd, last});
+                // (zoomed out, a cell is less than a pixel)
+                patternCells.push_back({topLeft.x, topLeft.y, std::max(1, bottomRight.x - topLeft.x), std::max(1, bottomRight.y - topLeft.y)});
+            }
+            x = runEnd;
+        }
+    }
+    renderer.setDrawColor(Color::PatternCell);
+    renderer.fillRects(patternCells);
+}
+
+void Game::renderDifference() const {
+    if (!difference) {
+        return;
+    }
+
+    std::vector<SDL_Rect> cells;
+    const Rect visible = coordinates.visibleRegion();
+    for (const Point& p : difference->cells) {
+        if (visible.contains(p)) {
+            const Point topLeft = coordinates.simToWindow(p);
+            const Point bottomRight = coordinates.simToWindow(p + Vector{1, 1});
+            cells.push_back({topLeft.x, topLeft.y, std::max(1, bottomRight.x - topLeft.x), std::max(1, bottomRight.y - topLeft.y)});
         }
-        renderer.setDrawColor(Color::PatternCell);
-        renderer.drawPoints(patternCells);
+    }
+    if (!cells.empty()) {
+        renderer.setDrawColor(Color::Difference);
+        renderer.fillRects(cells);
+    }
+}
+
+void Game::renderSelection() const {
+    if (selection.empty()) {
+        return;
     }
 
-    renderer.setTarget(nullptr);
-    renderer.copy(renderTexture.getRaw(), nullptr, nullptr);
+    const Point topLeft = coordinates.simToWindow(selection.position);
+    const Point bottomRight = coordinates.simToWindow(selection.position + Vector{selection.size.w, selection.size.h});
+    const SDL_Rect rect{topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y};
+    renderer.setDrawColor(Color::Selection);
+    renderer.drawRect(&rect);
 }
 
 void Game::renderGrid() const {
-    if (displayGrid == 1) {
+    if (displayGrid == 1 && coordinates.densityLevel() == 0) {
         renderer.copy(gridTexture.getRaw(), nullptr, nullptr);
     }
 }
 
 void Game::renderCells() {
-    renderer.setTarget(renderTexture.getRaw());
-
-    if (forceFullRedraw || selectedPattern != nullptr) {
+    if (forceFullRedraw || deltaBacklogTooLarge()) {
 
         // FULL mode
 
-        renderer.setDrawColor(Color::DeadCell);
-        renderer.fillRect(nullptr);
-
-        std::vector<SDL_Point> alives;
         forceFullRedraw = false;
-        for (int y = 0; y < coordinates.grid().h; y++) {
-            for (int x = 0; x < coordinates.grid().w; x++) {
-                Point p = coordinates.gridToSim({x, y});
-                if (p.x >= 0 && p.y >= 0 && p.x < simulation->size().w && p.y < simulation->size().h && simulation->get(p.x, p.y) == CellState::ALIVE) {
-                    alives.push_back({x, y});
-                }
+        const Rect viewport = simulation->viewport();
+        std::vector<Rect> occupied = simulation->occupiedTiles(viewport);
+        if (const int level = coordinates.densityLevel(); level > 0) {
+            // zoomed out: one pixel per block of the density pyramid, the parts become blocks
+            for (Rect& part : occupied) {
+                const Point end = part.position + Vector{part.size.w - 1, part.size.h - 1};
+                part = {{part.position.x >> level, part.position.y >> level}, {(end.x >> level) - (part.position.x >> level) + 1, (end.y >> level) - (part.position.y >> level) + 1}};
             }
-        }
-
-        if (!alives.empty()) {
-            renderer.setDrawColor(Color::AliveCell);
-            renderer.drawPoints(alives);
+            cellRenderer.redraw(simulation->density(level), coordinates.simToGrid({0, 0}), occupied);
+        } else {
+            for (Rect& part : occupied) {
+                part.position = part.position - Vector{viewport.position.x, viewport.position.y};
+            }
+            cellRenderer.redraw(simulation->viewportCells(), coordinates.simToGrid(viewport.position), occupied);
         }
     } else {
 
-        // DELTA mode
+        // DELTA mode: the visible cells which changed since the last frame get their current state
 
-        std::vector<SDL_Point> alives;
-        std::vector<SDL_Point> deads;
+        coalesceDeltas();
 
-        for (const auto& update : lastUpdates) {
-            for (const Cell& cell : *update) {
-                Point p = coordinates.simToGrid({cell.x, cell.y});
-                if (p.x >= 0 && p.y >= 0 && p.x < coordinates.grid().w && p.y < coordinates.grid().h) {
-                    std::vector<SDL_Point>& ref = cell.state == CellState::ALIVE ? alives : deads;
-                    ref.push_back({p.x, p.y});
-                }
+        const int width = simulation->size().w;
+        if (const int level = coordinates.densityLevel(); level > 0) {
+            // (zoomed out, the block of each of them is shaded again)
+            const DensityLevel& density = simulation->density(level);
+            for (const uint32_t index : netChanges) {
+                const Point cell{static_cast<int>(index % width), static_cast<int>(index / width)};
+                cellRenderer.shade(coordinates.simToGrid(cell), density.get(cell.x >> level, cell.y >> level));
             }
-
-            if (!alives.empty()) {
-                renderer.setDrawColor(Color::AliveCell);
-                renderer.drawPoints(alives);
+        } else {
+            for (const uint32_t index : netChanges) {
+                const Point cell{static_cast<int>(index % width), static_cast<int>(index / width)};
+                cellRenderer.set(coordinates.simToGrid(cell), simulation->get(cell.x, cell.y) == CellState::ALIVE);
             }
-            if (!deads.empty()) {
-                renderer.setDrawColor(Color::DeadCell);
-                renderer.drawPoints(deads);
+        }
+    }
+    drawnDeltas = simulation->deltaCount();
+
+    cellRenderer.render(renderer);
+}
+
+bool Game::deltaBacklogTooLarge() const {
+    const uint64_t backlog = simulation->deltaCount() - drawnDeltas;
+    if (backlog > Simulation::deltaRingSize) {
+        // some of them have already been recycled
+        return true;
+    }
+
+    // replaying the deltas stops being worth it when it costs more than redrawing all the visible cells
+    size_t toggles = 0;
+    for (uint64_t n = drawnDeltas + 1; n <= simulation->deltaCount(); n++) {
+        toggles += simulation->viewportDelta(n).size();
+    }
+    return toggles * toggleRenderCost > static_cast<size_t>(coordinates.grid().w) * coordinates.grid().h;
+}
+
+void Game::coalesceDeltas() {
+    // parity: a cell toggled an even number of times since the last frame (like a blinker's) is back to where it was
+    netChanges.clear();
+    for (uint64_t n = drawnDeltas + 1; n <= simulation->deltaCount(); n++) {
+        for (const uint32_t index : simulation->viewportDelta(n)) {
+            if (!netChanges.insert(index).second) {
+                netChanges.erase(index);
             }
-            alives.clear();
-            deads.clear();
         }
-        lastUpdates.clear();
     }
+}
 
-    renderer.setTarget(nullptr);
-    renderer.copy(renderTexture.getRaw(), nullptr, nullptr);
+bool Game::isIdle() const {
+    return (paused || simulation->frozen()) && !forceFullRedraw && drawnDeltas == simulation->deltaCount() && !step && !stepBack && !benchmark && !census && !clear && !randomFill && !saveCheckpoint && !restoreCheckpoint && !compare;
 }
 
 bool Game::mainLoop() {
     // EVENTS
+#ifndef __EMSCRIPTEN__
+    if (settled) {
+        // nothing to simulate or redraw: sleep until the next event instead of spinning
+        SDL_WaitEvent(nullptr);
+    }
+#endif
     std::vector<SDL_Event> events;
     for (SDL_Event event; SDL_PollEvent(&event) != 0;) {
         if (SDL_RENDER_TARGETS_RESET == event.type) {
@@ -404,8 +770,56 @@ bool Game::mainLoop() {
 
     // UPDATE and RENDER
     update();
+    // edits start a new timeline
+    history.record(*simulation);
+#ifndef __EMSCRIPTEN__
+    // (the background threads aren't available in the browser)
+    if (paused && lookAhead == 1 && !simulation->frozen()) {
+        if (runner && runner->editsPending()) {
+            // (the edits made while it was running don't wait behind the generations it computed ahead)
+            runner->stop(*simulation);
+        }
+        // the next steps are computed ahead, from the edited world once the mouse is released (not from each edit)
+        if (SDL_GetMouseState(nullptr, nullptr) == 0) {
+            if (!runner) {
+                runner = std::make_unique<SimulationRunner>(simSize);
+            }
+            runner->start(*simulation);
+            runner->allow(simulation->generation() + lookAheadDepth);
+        }
+    } else if (!paused && !simulation->frozen()) {
+        if (!runner) {
+            runner = std::make_unique<SimulationRunner>(simSize);
+        }
+        runner->start(*simulation);
+    } else if (runner) {
+        runner->stop(*simulation);
+    }
+#endif
+    timeline = static_cast<int>(simulation->generation());
+    timelineStart = static_cast<int>(history.oldest());
+    timelineEnd = static_cast<int>(history.newest());
+    population = simulation->population();
+    // the log has the last generation computed, unless the world was edited or moved since
+    const bool logged = !populationLog.empty() && populationLog.last().generation == simulation->generation() && populationLog.last().revision == simulation->revision();
+    visiblePopulation = logged ? populationLog.last().probePopulation : simulation->regionStats(coordinates.visibleRegion()).population;
+    births = logged ? populationLog.last().births : -1;
+    deaths = logged ? populationLog.last().deaths : -1;
+    viewport = coordinates.visibleRegion();
+    minimap.update(*simulation);
+    boundingBox = simulation->boundingBox();
+    period = simulation->period().value_or(0);
+    frozen = simulation->frozen();
+    if (difference && (simulation->revision() != differenceRevision || simulation->generation() != differenceGeneration)) {
+        difference.reset();
+    }
+    differences = difference ? difference->count : -1;
+    differenceBounds = difference ? difference->boundingBox : Rect{};
     render();
 
+    // one more frame is rendered after the last change, so that the GUI shows the final state
+    settled = events.empty() && isIdle();
+
     return false;
 }
 
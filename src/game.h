@@ -1,13 +1,20 @@
 #pragma once
 
+#include "cell_renderer.h"
+#include "census.h"
 #include "clock.h"
 #include "gui.h"
+#include "history.h"
+#include "minimap.h"
 #include "nuklear_sdl.h"
 #include "pattern.h"
+#include "population_log.h"
 #include "primitives.h"
 #include "sdl_wrappers.h"
 #include "simulation.h"
+#include "simulation_runner.h"
 
+#include <algorithm>
 #include <span>
 #include <vector>
 
@@ -18,6 +25,8 @@ public:
     Coordinates(Size sim, Size window, int gridCellSize) : m_sim(sim), m_window(window), m_gridCellSize(gridCellSize) {}
 
     [[nodiscard]] int gridCellSize() const { return m_gridCellSize; }
+    // zoomed out (a cell size below 1): each grid cell is a pixel showing a block of 2^level x 2^level cells, 0 otherwise
+    [[nodiscard]] int densityLevel() const { return m_densityLevel; }
     [[nodiscard]] Size window() const { return m_window; }
     [[nodiscard]] Size grid() const { return m_grid; }
 
@@ -25,18 +34,30 @@ public:
                 static_cast<int>(p.x * windowToGridScaleX),
                 static_cast<int>(p.y * windowToGridScaleY)};
     }
-    [[nodiscard]] Point gridToSim(Point p) const { return p + gridToSimOffset; }
-    [[nodiscard]] Point simToGrid(Point p) const { return p - gridToSimOffset; }
+    [[nodiscard]] Point gridToSim(Point p) const { return Point{p.x << m_densityLevel, p.y << m_densityLevel} + gridToSimOffset; }
+    [[nodiscard]] Point simToGrid(Point p) const {
+        const Point q = p - gridToSimOffset;
+        return {q.x >> m_densityLevel, q.y >> m_densityLevel};
+    }
     [[nodiscard]] Point windowToSim(Point p) const { return gridToSim(windowToGrid(p)); }
+    [[nodiscard]] Point gridToWindow(Point p) const {return {
+                static_cast<int>(p.x / windowToGridScaleX),
+                static_cast<int>(p.y / windowToGridScaleY)};
+    }
+    [[nodiscard]] Point simToWindow(Point p) const { return gridToWindow(simToGrid(p)); }
+    // (zoomed out, it can be larger than the world)
+    [[nodiscard]] Rect visibleRegion() const { return {gridToSim({0, 0}), {m_grid.w << m_densityLevel, m_grid.h << m_densityLevel}}; }
 
 private:
     Size m_sim;
     Size m_window;
     int m_gridCellSize;
 
-    Size m_grid = m_window / m_gridCellSize;
+    int m_densityLevel = m_gridCellSize < 1 ? 1 - m_gridCellSize : 0;
+    Size m_grid = m_window / std::max(1, m_gridCellSize);
 
-    Vector gridToSimOffset = Vector{m_sim.w - m_grid.w, m_sim.h - m_grid.h} / 2;
+    // (a whole number of blocks)
+    Vector gridToSimOffset = Vector{((m_sim.w >> m_densityLevel) - m_grid.w) / 2 * (1 << m_densityLevel), ((m_sim.h >> m_densityLevel) - m_grid.h) / 2 * (1 << m_densityLevel)};
     double windowToGridScaleX = static_cast<double>(m_grid.w) / m_window.w;
     double windowToGridScaleY = static_cast<double>(m_grid.h) / m_window.h;
 };
@@ -57,20 +78,53 @@ private:
     bool paused = true;
     bool benchmark = false;
     bool step = false;
+    bool stepBack = false;
     bool clear = false;
+    bool randomFill = false;
+    bool census = false;
+    bool saveCheckpoint = false;
+    bool restoreCheckpoint = false;
+    bool compare = false;
 
     // status
     const Pattern* selectedPattern = nullptr;
+    Transform patternTransform = Transform::Identity;
     bool modalGui = false;
+    Rect selection;
+    Point selectionStart;
+    bool selecting = false;
+    Pattern clipboard;
+    Bitmap patternPreview; // the selected pattern, transformed
+    const Pattern* previewedPattern = nullptr;
+    Transform previewedTransform = Transform::Identity;
     bool gridAutoDisabled = false;
     int iteration = 0;
+    int timeline = 0;
+    int timelineStart = 0;
+    int timelineEnd = 0;
+    int64_t population = 0;
+    int64_t visiblePopulation = 0;
+    int births = -1; // in the last generation, -1 if it wasn't computed (an edit or a seek since)
+    int deaths = -1;
+    Rect viewport;
+    Rect boundingBox;
+    int period = 0;
+    bool periodic = false;
+    bool frozen = false;
+    int64_t differences = -1;
+    Rect differenceBounds;
+    bool settled = false;
     bool forceFullRedraw = true;
-    std::vector<std::shared_ptr<std::vector<Cell>>> lastUpdates;
+    uint64_t drawnDeltas = 0; // deltas of the simulation already on screen
+    robin_hood::unordered_set<uint32_t> netChanges;
 
     // options
     int displayGrid = 1;
+    int autoPause = 0;
+    int lookAhead = 0;
     int updateSpeedPower = 5;
     int cellSize = 12;
+    uint64_t soupSeed = 1;
 
     sdl::Window* window;
     sdl::Cursor cursor;
@@ -79,8 +133,17 @@ private:
     sdl::Renderer renderer;
     Coordinates coordinates;
     sdl::Texture gridTexture;
-    sdl::Texture renderTexture;
+    CellRenderer cellRenderer;
+    PopulationLog populationLog; // observes the world (probe: the visible region)
     std::unique_ptr<Simulation> simulation;
+    Minimap minimap;
+    Snapshot checkpoint;
+    std::optional<WorldDiff> difference; // highlighted until the world changes
+    uint64_t differenceRevision = 0;
+    int64_t differenceGeneration = 0;
+    History history;
+    std::unique_ptr<SimulationRunner> runner; // from the first time the world runs (or looks ahead)
+    Census objectCensus;
     NuklearSdl nuklearSdl;
     GuiBindings bindings;
     Gui gui;
@@ -89,22 +152,41 @@ private:
     void handleEvents(std::span<SDL_Event> events, bool mouseOnGui);
 
     void mouseEdit(CellState state);
+    void edit(const EditCommand& command);
+    void selectTo(Point point);
+
+    void copySelection();
+    void clearSelection();
+    void cutSelection();
+    void transformSelection(Transform transform);
+    void paste();
 
     void update();
+    bool seek(int64_t generation);
+
+    [[nodiscard]] bool isIdle() const;
 
     void render();
 
     void onCoordinatesChanged();
+    void subscribeRenderer();
 
     void resetSimClock();
 
     void renderCells();
+    [[nodiscard]] bool deltaBacklogTooLarge() const;
+    void coalesceDeltas();
     void renderGrid() const;
-    void renderSelectedPattern() const;
+    void renderSelectedPattern();
+    void renderSelection() const;
+    void renderDifference() const;
 
     void placeSelectedPattern();
+    [[nodiscard]] Vector selectedPatternOffset() const;
 
     void runBenchmark();
+
+    void runCensus();
 };
 
 }  // namespace app
@@ -5,6 +5,7 @@
 #include "colors.h"
 
 #include <array>
+#include <string>
 #include <utility>
 
 #include <fmt/format.h>
@@ -104,9 +105,21 @@ namespace {
         return texture;
     }
 
+    sdl::Texture previous(const sdl::Renderer &renderer) {
+        int texSize = 128;
+        sdl::Texture texture{SDL_CreateTexture(renderer.getRaw(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, texSize, texSize)};
+        texture.setBlendMode(SDL_BLENDMODE_BLEND);
+        renderer.setTarget(texture.getRaw());
+        filledTrigonRGBA(renderer.getRaw(), 98, 12, 30, 64, 98,116, 52, 119, 235, 255);
+        thickLineRGBA(renderer.getRaw(), 30, 12, 30, 116, 16, 52, 119, 235, 255);
+
+        renderer.setTarget(nullptr);
+        return texture;
+    }
+
     constexpr int minSpeed = 0;
     constexpr int maxSpeed = 10;
-    constexpr int minCellSize = 1;
+    constexpr int minCellSize = -3; // below 1: 2, 4, 8 then 16 cells per pixel
     constexpr int maxCellSize = 32;
     constexpr int widgetSize = 180;
 
@@ -152,6 +165,7 @@ void Gui::onSdlContextLost() {
     playIcon.reset();
     pauseIcon.reset();
     nextIcon.reset();
+    previousIcon.reset();
 }
 
 void Gui::update(const sdl::Renderer& renderer) {
@@ -176,6 +190,11 @@ void Gui::update(const sdl::Renderer& renderer) {
         nextIcon->texture = next(renderer);
         nextIcon->image = nk_image_ptr(nextIcon->texture.getRaw());
     }
+    if (!previousIcon) {
+        previousIcon = std::make_unique<NkIcon>();
+        previousIcon->texture = previous(renderer);
+        previousIcon->image = nk_image_ptr(previousIcon->texture.getRaw());
+    }
 
     patternMenu(renderer);
     mainMenu(renderer.getOutputSize());
@@ -193,24 +212,53 @@ void Gui::mainMenu(const Size &viewPort) {
         nk_layout_row_dynamic(pNuklearCtx, 8, 1);
 
         // Buttons
-        nk_layout_row_begin(pNuklearCtx, NK_DYNAMIC, 0, 3);
+        nk_layout_row_begin(pNuklearCtx, NK_DYNAMIC, 0, 4);
         struct nk_style_button style = pNuklearCtx->style.button;
-        nk_layout_row_push(pNuklearCtx, 0.25F);
+        nk_layout_row_push(pNuklearCtx, 0.2F);
+        if (1 == nk_button_image_styled(pNuklearCtx, &style, previousIcon->image)) {
+            *bindings.stepBack = true;
+        }
+        nk_layout_row_push(pNuklearCtx, 0.2F);
         if (1 == nk_button_image_styled(pNuklearCtx, &style, *bindings.paused ? playIcon->image : pauseIcon->image)) {
             *bindings.paused = !*bindings.paused;
         }
-        nk_layout_row_push(pNuklearCtx, 0.25F);
+        nk_layout_row_push(pNuklearCtx, 0.2F);
         if (1 == nk_button_image_styled(pNuklearCtx, &style, nextIcon->image)) {
             *bindings.step = true;
         }
-        nk_layout_row_push(pNuklearCtx, 0.5F);
+        nk_layout_row_push(pNuklearCtx, 0.4F);
         iteration = std::to_string(*bindings.iteration);
         nk_text(pNuklearCtx, iteration.c_str(), 12, NK_TEXT_ALIGN_RIGHT | NK_TEXT_ALIGN_MIDDLE);
         nk_layout_row_end(pNuklearCtx);
 
+        // Statistics
+        nk_layout_row_dynamic(pNuklearCtx, 20, 1);
+        nk_label(pNuklearCtx, fmt::format("Population: {}", *bindings.population).c_str(), NK_TEXT_ALIGN_LEFT);
+        nk_label(pNuklearCtx, fmt::format("Visible: {}", *bindings.visiblePopulation).c_str(), NK_TEXT_ALIGN_LEFT);
+        nk_label(pNuklearCtx, *bindings.births < 0 ? "Born / died: -" : fmt::format("Born / died: {} / {}", *bindings.births, *bindings.deaths).c_str(), NK_TEXT_ALIGN_LEFT);
+        nk_label(pNuklearCtx, fmt::format("Bounds: {} x {}", bindings.boundingBox->size.w, bindings.boundingBox->size.h).c_str(), NK_TEXT_ALIGN_LEFT);
+        nk_label(pNuklearCtx, *bindings.period == 0 ? "Period: -" : fmt::format("Period: {}", *bindings.period).c_str(), NK_TEXT_ALIGN_LEFT);
+        nk_label(pNuklearCtx, *bindings.frozen ? "State: frozen" : "State: evolving", NK_TEXT_ALIGN_LEFT);
+
+        // Timeline slider
+        nk_label(pNuklearCtx, fmt::format("History: {} - {}", *bindings.timelineStart, *bindings.timelineEnd).c_str(), NK_TEXT_ALIGN_LEFT);
+        nk_layout_row_dynamic(pNuklearCtx, 16, 1);
+        if (*bindings.timelineEnd > *bindings.timelineStart) {
+            nk_slider_int(pNuklearCtx, *bindings.timelineStart, bindings.timeline, *bindings.timelineEnd, 1);
+        } else {
+            nk_spacing(pNuklearCtx, 1);
+        }
+
+        // Minimap
+        nk_layout_row_dynamic(pNuklearCtx, 8, 1);
+        minimap(static_cast<float>(panelSize.w) - 2 * pNuklearCtx->style.window.padding.x);
+
         // Grid checkbox
         nk_layout_row_dynamic(pNuklearCtx, 50, 1);
         nk_checkbox_label(pNuklearCtx, "show grid", bindings.displayGrid);
+        nk_layout_row_dynamic(pNuklearCtx, 30, 1);
+        nk_checkbox_label(pNuklearCtx, "pause on cycle", bindings.autoPause);
+        nk_checkbox_label(pNuklearCtx, "look ahead when paused", bindings.lookAhead);
 
         // Speed slider
         nk_layout_row_dynamic(pNuklearCtx, 20, 1);
@@ -226,7 +274,8 @@ void Gui::mainMenu(const Size &viewPort) {
         nk_layout_row_dynamic(pNuklearCtx, 16, 1);
         nk_slider_int(pNuklearCtx, minCellSize, bindings.cellSize, maxCellSize, 1);
         nk_layout_row_dynamic(pNuklearCtx, 0, 1);
-        nk_label(pNuklearCtx, fmt::format("{}", *bindings.cellSize).c_str(), NK_TEXT_ALIGN_CENTERED | NK_TEXT_ALIGN_TOP);
+        const std::string zoom = *bindings.cellSize >= 1 ? fmt::format("{}", *bindings.cellSize) : fmt::format("1/{}", 1 << (1 - *bindings.cellSize));
+        nk_label(pNuklearCtx, zoom.c_str(), NK_TEXT_ALIGN_CENTERED | NK_TEXT_ALIGN_TOP);
 
         // patterns
         nk_layout_row_dynamic(pNuklearCtx, 0, 1);
@@ -239,10 +288,58 @@ void Gui::mainMenu(const Size &viewPort) {
         if (1 == nk_button_label(pNuklearCtx, "Clear")) {
             *bindings.clear = true;
         }
+
+        // random soup
+        nk_layout_row_dynamic(pNuklearCtx, 0, 1);
+        if (1 == nk_button_label(pNuklearCtx, "Random soup")) {
+            *bindings.randomFill = true;
+        }
+
+        // census
+        nk_layout_row_dynamic(pNuklearCtx, 0, 1);
+        if (1 == nk_button_label(pNuklearCtx, "Census")) {
+            *bindings.census = true;
+        }
+
+        // checkpoint
+        nk_layout_row_dynamic(pNuklearCtx, 0, 2);
+        if (1 == nk_button_label(pNuklearCtx, "Checkpoint")) {
+            *bindings.saveCheckpoint = true;
+        }
+        if (1 == nk_button_label(pNuklearCtx, "Restore")) {
+            *bindings.restoreCheckpoint = true;
+        }
+        nk_layout_row_dynamic(pNuklearCtx, 0, 1);
+        if (1 == nk_button_label(pNuklearCtx, "Compare to checkpoint")) {
+            *bindings.compare = true;
+        }
+        if (*bindings.differences >= 0) {
+            nk_label(pNuklearCtx, fmt::format("Differences: {} in {} x {}", *bindings.differences, bindings.differenceBounds->size.w, bindings.differenceBounds->size.h).c_str(), NK_TEXT_ALIGN_LEFT);
+        }
     }
     nk_end(pNuklearCtx);
 }
 
+void Gui::minimap(float width) {
+    // the whole world (tile by tile) with the visible part outlined
+    const Size tiles = bindings.minimap->tiles();
+    nk_layout_row_dynamic(pNuklearCtx, width * static_cast<float>(tiles.h) / static_cast<float>(tiles.w), 1);
+    struct nk_rect bounds{};
+    if (nk_widget(&bounds, pNuklearCtx) == NK_WIDGET_INVALID) {
+        return;
+    }
+    nk_command_buffer* canvas = nk_window_get_canvas(pNuklearCtx);
+    const struct nk_image image = nk_image_ptr(bindings.minimap->texture());
+    nk_draw_image(canvas, bounds, &image, nk_rgba(255, 255, 255, 255));
+
+    const Size area{tiles.w * Simulation::tileSize, tiles.h * Simulation::tileSize};
+    const Rect visible = intersect(*bindings.viewport, {{0, 0}, area});
+    const float scale = bounds.w / static_cast<float>(area.w);
+    const struct nk_rect outline = nk_rect(bounds.x + static_cast<float>(visible.position.x) * scale, bounds.y + static_cast<float>(visible.position.y) * scale,
+                                           static_cast<float>(visible.size.w) * scale, static_cast<float>(visible.size.h) * scale);
+    nk_stroke_rect(canvas, outline, 0, 1, nk_rgba(235, 119, 52, 255));
+}
+
 void Gui::patternMenu(const sdl::Renderer& renderer) {
     if (!*bindings.patternModalOpened) {
         return;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../deps/nuklear/nuklear.h"
+#include "minimap.h"
 #include "pattern.h"
 #include "sdl_wrappers.h"
 
@@ -10,15 +11,37 @@ namespace app {
 
 struct GuiBindings {
     int* displayGrid;
+    int* autoPause;
+    int* lookAhead;
     int* speed;
     bool* paused;
     int* cellSize;
     const Pattern** selectedPattern;
     bool* patternModalOpened;
     bool* step;
+    bool* stepBack;
     bool* clear;
+    bool* randomFill;
+    bool* census;
+    bool* saveCheckpoint;
+    bool* restoreCheckpoint;
+    bool* compare;
 
     int* iteration;
+    int* timeline;
+    const int* timelineStart;
+    const int* timelineEnd;
+    const int64_t* population;
+    const int64_t* visiblePopulation;
+    const int* births;
+    const int* deaths;
+    const Rect* boundingBox;
+    const int* period;
+    const bool* frozen;
+    const int64_t* differences;
+    const Rect* differenceBounds;
+    const Minimap* minimap;
+    const Rect* viewport;
 };
 
 struct NkIcon {
@@ -41,10 +64,12 @@ private:
     std::unique_ptr<NkIcon> playIcon;
     std::unique_ptr<NkIcon> pauseIcon;
     std::unique_ptr<NkIcon> nextIcon;
+    std::unique_ptr<NkIcon> previousIcon;
     std::string iteration = "0";
 
     void mainMenu(const Size &viewPort);
     void patternMenu(const sdl::Renderer& renderer);
+    void minimap(float width);
 };
 
 } // namespace app
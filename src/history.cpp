@@ -0,0 +1,134 @@
+#include "history.h"
+
+#include <algorithm>
+
+namespace app {
+
+size_t History::memoryUsage() const {
+    return framesMemory + keyframesMemory + (keyframes.empty() ? 0 : keyframes.back().snapshot.memoryUsage());
+}
+
+bool History::follows(const Simulation& simulation) const {
+    return !keyframes.empty() && simulation.revision() == revision;
+}
+
+void History::record(Simulation& simulation) {
+    const int64_t generation = simulation.generation();
+    if (!follows(simulation) || generation < position || generation > position + 1) {
+        clear();
+        start = position = generation;
+        addKeyframe(simulation);
+        revision = simulation.revision();
+        return;
+    }
+    if (generation == position) {
+        return;
+    }
+
+    // stepping from an earlier generation replaces what followed it
+    truncate(position);
+
+    std::vector<uint32_t> frame{simulation.toggles().begin(), simulation.toggles().end()};
+    framesMemory += frame.size() * sizeof(uint32_t);
+    framesMemorySinceKeyframe += frame.size() * sizeof(uint32_t);
+    frames.push_back(std::move(frame));
+    position = generation;
+
+    if (position - keyframes.back().generation >= keyframeInterval || framesMemorySinceKeyframe > memoryBudget / 8) {
+        addKeyframe(simulation);
+    }
+    trim();
+}
+
+void History::clear() {
+    frames.clear();
+    keyframes.clear();
+    framesMemory = 0;
+    keyframesMemory = 0;
+    framesMemorySinceKeyframe = 0;
+    start = position = 0;
+}
+
+bool History::seek(Simulation& simulation, int64_t generation) {
+    if (!follows(simulation) || simulation.generation() != position || generation < start || generation > newest()) {
+        return false;
+    }
+    if (generation == position) {
+        return true;
+    }
+
+    // replay the steps from where the world is, or from the closest keyframe if that touches less memory
+    const auto keyframe = std::prev(std::upper_bound(keyframes.begin(), keyframes.end(), generation,
+        [](int64_t g, const Keyframe& k) { return g < k.generation; }));
+    const size_t replayCost = framesMemoryBetween(std::min(position, generation), std::max(position, generation));
+    const size_t keyframeCost = keyframe->snapshot.memoryUsage() + framesMemoryBetween(keyframe->generation, generation);
+    bool restored = false;
+    if (generation == start || keyframeCost < replayCost) {
+        // (the step which produced the oldest generation isn't recorded, only its keyframe knows what comes next)
+        simulation.restore(keyframe->snapshot);
+        position = keyframe->generation;
+        restored = true;
+    }
+
+    while (position > generation) {
+        position--;
+        simulation.toggle(frames[position - start]);
+    }
+    while (position < generation) {
+        simulation.toggle(frames[position - start]);
+        position++;
+    }
+    if (!restored || keyframe->generation != generation) {
+        simulation.seek(generation, frames[generation - 1 - start]);
+    }
+    revision = simulation.revision();
+    return true;
+}
+
+void History::addKeyframe(Simulation& simulation) {
+    if (!keyframes.empty()) {
+        keyframes.back().memory = keyframes.back().snapshot.memoryUsage();
+        keyframesMemory += keyframes.back().memory;
+    }
+    keyframes.push_back({simulation.generation(), simulation.snapshot()});
+    framesMemorySinceKeyframe = 0;
+}
+
+void History::truncate(int64_t generation) {
+    if (newest() <= generation) {
+        return;
+    }
+    while (newest() > generation) {
+        framesMemory -= frames.back().size() * sizeof(uint32_t);
+        frames.pop_back();
+    }
+    while (keyframes.back().generation > generation) {
+        keyframes.pop_back();
+        // (the tiles it shared with the previous one are that one's again)
+        keyframesMemory -= keyframes.back().memory;
+    }
+    framesMemorySinceKeyframe = framesMemoryBetween(keyframes.back().generation, generation);
+}
+
+void History::trim() {
+    // the oldest keyframe goes with the steps up to the next one
+    while (memoryUsage() > memoryBudget && keyframes.size() > 1) {
+        while (start < keyframes[1].generation) {
+            framesMemory -= frames.front().size() * sizeof(uint32_t);
+            frames.pop_front();
+            start++;
+        }
+        keyframesMemory -= keyframes.front().memory;
+        keyframes.pop_front();
+    }
+}
+
+size_t History::framesMemoryBetween(int64_t from, int64_t to) const {
+    size_t memory = 0;
+    for (int64_t generation = from; generation < to; generation++) {
+        memory += frames[generation - start].size() * sizeof(uint32_t);
+    }
+    return memory;
+}
+
+}  // namespace app
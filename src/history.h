@@ -0,0 +1,61 @@
+#pragma once
+
+#include "simulation.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace app {
+
+// Timeline of the recent generations of a world, to go back and forth without re-running it.
+// Each step is stored as the list of the cells it toggled, which is its own inverse, and a snapshot is kept every few
+// generations so that long jumps don't have to replay every step. The oldest generations are dropped to stay within
+// the memory budget.
+class History {
+public:
+    static constexpr int keyframeInterval = 256;
+
+    explicit History(size_t memoryBudget) : memoryBudget{memoryBudget} {}
+
+    // to call after each step and each edit: an edit starts a new timeline
+    void record(Simulation& simulation);
+    void clear();
+
+    [[nodiscard]] bool empty() const { return keyframes.empty(); }
+    [[nodiscard]] int64_t oldest() const { return start; }
+    [[nodiscard]] int64_t newest() const { return start + static_cast<int64_t>(frames.size()); }
+    [[nodiscard]] size_t memoryUsage() const;
+
+    // moves the world to a recorded generation, returns false if it isn't in the timeline
+    bool seek(Simulation& simulation, int64_t generation);
+
+private:
+    // A tile copied by the world goes to every snapshot which didn't have it yet, the newest keyframe included: it's
+    // counted once, with the newest keyframe at the time. So the memory of a keyframe is fixed once there is a newer
+    // one, only the newest one grows with the world.
+    struct Keyframe {
+        int64_t generation;
+        Snapshot snapshot;
+        size_t memory = 0; // once there is a newer keyframe
+    };
+
+    size_t memoryBudget;
+    int64_t start = 0;
+    int64_t position = 0; // generation of the world in the timeline
+    uint64_t revision = 0;
+    std::deque<std::vector<uint32_t>> frames; // frames[i]: the cells toggled from generation start + i to the next one
+    std::deque<Keyframe> keyframes;
+    size_t framesMemory = 0;
+    size_t keyframesMemory = 0; // of all the keyframes but the newest
+    size_t framesMemorySinceKeyframe = 0;
+
+    [[nodiscard]] bool follows(const Simulation& simulation) const;
+    void addKeyframe(Simulation& simulation);
+    void truncate(int64_t generation);
+    void trim();
+    [[nodiscard]] size_t framesMemoryBetween(int64_t from, int64_t to) const;
+};
+
+}  // namespace app
@@ -0,0 +1,45 @@
+#include "minimap.h"
+
+#include "cell_renderer.h"
+
+namespace app {
+
+Minimap::Minimap(const sdl::Renderer& renderer, Size tiles) :
+    m_tiles{tiles},
+    m_texture{SDL_CreateTexture(renderer.getRaw(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, tiles.w, tiles.h)},
+    pixels(static_cast<size_t>(tiles.w) * tiles.h),
+    shades{aliveShades(Simulation::tileSize * Simulation::tileSize)} {
+}
+
+void Minimap::update(const Simulation& simulation) {
+    // the deltas since the last update can be replayed if they're all still there and nothing else happened in between
+    const uint64_t deltas = simulation.deltaCount() - deltaCount;
+    const bool replay = &simulation == world && simulation.revision() == revision && deltas <= Simulation::deltaRingSize
+                        && simulation.generation() - generation == static_cast<int64_t>(deltas);
+    if (replay) {
+        for (uint64_t n = deltaCount + 1; n <= simulation.deltaCount(); n++) {
+            for (const uint32_t tile : simulation.tileDelta(n)) {
+                shade(simulation, tile);
+            }
+        }
+    } else {
+        for (uint32_t tile = 0; tile < pixels.size(); tile++) {
+            shade(simulation, tile);
+        }
+    }
+    world = &simulation;
+    revision = simulation.revision();
+    generation = simulation.generation();
+    deltaCount = simulation.deltaCount();
+
+    if (!replay || deltas > 0) {
+        // (a few dozen kilobytes)
+        m_texture.update(nullptr, pixels.data(), m_tiles.w * static_cast<int>(sizeof(uint32_t)));
+    }
+}
+
+void Minimap::shade(const Simulation& simulation, uint32_t tile) {
+    pixels[tile] = shades[simulation.tilePopulation(static_cast<int>(tile % m_tiles.w), static_cast<int>(tile / m_tiles.w))];
+}
+
+}  // namespace app
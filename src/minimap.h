@@ -0,0 +1,37 @@
+#pragma once
+
+#include "primitives.h"
+#include "sdl_wrappers.h"
+#include "simulation.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace app {
+
+// The whole world at one pixel per tile, shaded by the population of the tile. Only the tiles listed by the deltas since
+// the last update are shaded again, everything after an edit, a seek or when the deltas have been recycled.
+class Minimap {
+public:
+    Minimap(const sdl::Renderer& renderer, Size tiles);
+
+    [[nodiscard]] Size tiles() const { return m_tiles; }
+    [[nodiscard]] SDL_Texture* texture() const { return m_texture.getRaw(); }
+
+    void update(const Simulation& simulation);
+
+private:
+    Size m_tiles;
+    sdl::Texture m_texture;
+    std::vector<uint32_t> pixels;
+    std::vector<uint32_t> shades; // by tile population
+    // what the pixels show
+    const Simulation* world = nullptr;
+    uint64_t revision = 0;
+    int64_t generation = 0;
+    uint64_t deltaCount = 0;
+
+    void shade(const Simulation& simulation, uint32_t tile);
+};
+
+}  // namespace app
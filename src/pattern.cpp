@@ -81,6 +81,9 @@ namespace {
     }
 
     Size getSize(Pattern::TCells cells) {
+        if (cells.empty()) {
+            return {};
+        }
         auto min_max_x = std::minmax_element(cells.begin(), cells.end(), [](auto p1, auto p2) { return p1.x < p2.x; });
         auto min_max_y = std::minmax_element(cells.begin(), cells.end(), [](auto p1, auto p2) { return p1.y < p2.y; });
         return Size{
@@ -93,7 +96,11 @@ namespace {
 
 
 Pattern::Pattern(string_view name, TCells aliveCells) : m_name{name}, m_aliveCells{std::move(aliveCells)},
-    m_size{getSize(m_aliveCells)} {
+    m_size{getSize(m_aliveCells)}, m_bitmap{Bitmap::fromCells(m_aliveCells)} {
+}
+
+Pattern::Pattern(string_view name, Bitmap bitmap) : m_name{name}, m_aliveCells{bitmap.aliveCells()}, m_size{bitmap.size()},
+    m_bitmap{std::move(bitmap)} {
 }
 
 Pattern loadPlaintext(string_view name, const std::vector<string>& strings) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "bitmap.h"
 #include "primitives.h"
 
 #include <optional>
@@ -17,15 +18,19 @@ public:
 
     Pattern() = default;
     Pattern(std::string_view name, TCells aliveCells);
+    // the cells of the bitmap, which keeps its size (empty borders included)
+    Pattern(std::string_view name, Bitmap bitmap);
 
     [[nodiscard]] const std::string& name() const { return m_name; }
     [[nodiscard]] const TCells& aliveCells() const { return m_aliveCells; }
     [[nodiscard]] const Size& size() const { return m_size; }
+    [[nodiscard]] const Bitmap& bitmap() const { return m_bitmap; }
 
 private:
     std::string m_name;
     std::vector<Point> m_aliveCells;
     Size m_size;
+    Bitmap m_bitmap;
 };
 
 std::optional<Pattern> loadFromFile(std::string_view fileName, std::string_view filePath);
@@ -67,7 +72,7 @@ namespace Patterns {
     }
     
     inline Pattern spaceship() {
-        return loadPlaintext("Glider", {
+        return loadPlaintext("Middleweight spaceship", {
             "..O...",
             "O...O.",
             ".....O",
@@ -85,6 +90,24 @@ namespace Patterns {
     inline std::vector<Pattern> defaultPatterns() {
         return { acorn(), r_pentomino(), diehard(), glider(), spaceship(), infinite() };
     }
+
+    // the most frequent objects found in the ash of random soups
+    inline std::vector<Pattern> commonObjects() {
+        return {
+            loadPlaintext("Block", {"OO", "OO"}),
+            loadPlaintext("Blinker", {"OOO"}),
+            loadPlaintext("Beehive", {".OO.", "O..O", ".OO."}),
+            loadPlaintext("Loaf", {".OO.", "O..O", ".O.O", "..O."}),
+            loadPlaintext("Boat", {"OO.", "O.O", ".O."}),
+            loadPlaintext("Ship", {"OO.", "O.O", ".OO"}),
+            loadPlaintext("Tub", {".O.", "O.O", ".O."}),
+            loadPlaintext("Pond", {".OO.", "O..O", "O..O", ".OO."}),
+            loadPlaintext("Long boat", {"OO..", "O.O.", ".O.O", "..O."}),
+            loadPlaintext("Toad", {".OOO", "OOO."}),
+            loadPlaintext("Beacon", {"OO..", "O...", "...O", "..OO"}),
+            glider(),
+        };
+    }
     
 } // namespace Patterns
 
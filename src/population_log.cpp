@@ -0,0 +1,33 @@
+#include "population_log.h"
+
+namespace app {
+
+void PopulationLog::setProbe(Rect region) {
+    if (region.position != m_probe.position || region.size != m_probe.size) {
+        m_probe = region;
+        samples.clear();
+    }
+}
+
+void PopulationLog::onStep(const Simulation& simulation, std::span<const uint32_t> toggles) {
+    // the toggled cells are in their new state: the live ones were born
+    const int width = simulation.size().w;
+    int births = 0;
+    for (const uint32_t index : toggles) {
+        const int y = static_cast<int>(index) / width;
+        births += simulation.get(static_cast<int>(index) - y * width, y);
+    }
+
+    if (samples.size() == capacity) {
+        samples.pop_front();
+    }
+    samples.push_back({
+            simulation.generation(),
+            simulation.revision(),
+            simulation.population(),
+            births,
+            static_cast<int>(toggles.size()) - births,
+            simulation.regionStats(m_probe).population});
+}
+
+}  // namespace app
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "primitives.h"
+#include "simulation.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+
+namespace app {
+
+struct PopulationSample {
+    int64_t generation{};
+    uint64_t revision{}; // of the world when the sample was taken
+    int64_t population{};
+    int births{};
+    int deaths{};
+    int64_t probePopulation{}; // in the probe region
+};
+
+// The population of the recent generations, taken as they're computed (a step observer: registered with
+// Simulation::addObserver() or passed to nextStep()). Only the last capacity samples are kept.
+class PopulationLog final : public StepObserver {
+public:
+    explicit PopulationLog(size_t capacity) : capacity{capacity} {}
+
+    // the samples are of a single probe region: changing it starts a new log
+    void setProbe(Rect region);
+    [[nodiscard]] Rect probe() const { return m_probe; }
+    void clear() { samples.clear(); }
+
+    [[nodiscard]] bool empty() const { return samples.empty(); }
+    [[nodiscard]] const PopulationSample& last() const { return samples.back(); }
+    [[nodiscard]] const std::deque<PopulationSample>& all() const { return samples; }
+
+    void onStep(const Simulation& simulation, std::span<const uint32_t> toggles) override;
+
+private:
+    size_t capacity;
+    Rect m_probe;
+    std::deque<PopulationSample> samples;
+};
+
+}  // namespace app
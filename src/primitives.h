@@ -1,7 +1,9 @@
 #pragma once
 
 #include "../deps/nuklear/nuklear.h"
+#include <algorithm>
 #include <compare>
+#include <cstdint>
 
 namespace app {
 
@@ -33,6 +35,8 @@ inline Point operator+(Vector v, Point p) {
 struct Size {
     int w{};
     int h{};
+
+    bool operator==(const Size& s) const { return s.w == w && s.h == h; };
 };
 inline Size operator/(Size s, int d) {
     return {s.w / d, s.h / d};
@@ -47,8 +51,71 @@ inline Size operator+(int d, Size s) {
 struct Rect {
     Point position{};
     Size size{};
+
+    [[nodiscard]] bool empty() const { return size.w <= 0 || size.h <= 0; }
+    [[nodiscard]] bool contains(Point p) const {
+        return p.x >= position.x && p.y >= position.y && p.x < position.x + size.w && p.y < position.y + size.h;
+    }
 };
 
+inline Rect intersect(Rect a, Rect b) {
+    const int x1 = std::max(a.position.x, b.position.x);
+    const int y1 = std::max(a.position.y, b.position.y);
+    const int x2 = std::min(a.position.x + a.size.w, b.position.x + b.size.w);
+    const int y2 = std::min(a.position.y + a.size.h, b.position.y + b.size.h);
+    return {{x1, y1}, {std::max(0, x2 - x1), std::max(0, y2 - y1)}};
+}
+
+// The 8 symmetries of the square: quarter turns clockwise, optionally after a horizontal flip
+enum class Transform : uint8_t {
+    Identity,
+    Rotate90,
+    Rotate180,
+    Rotate270,
+    Flip,
+    FlipRotate90,
+    FlipRotate180,
+    FlipRotate270
+};
+
+constexpr int transformCount = 8;
+
+inline Transform rotated(Transform t) {
+    const auto value = static_cast<uint8_t>(t);
+    return static_cast<Transform>((value & 4U) | ((value + 1U) & 3U));
+}
+
+inline Transform flipped(Transform t) {
+    // flipping after a rotation by r is the same as rotating by -r after a flip
+    const auto value = static_cast<uint8_t>(t);
+    return static_cast<Transform>((~value & 4U) | ((4U - value) & 3U));
+}
+
+inline Size transform(Size s, Transform t) {
+    return (static_cast<uint8_t>(t) & 1U) != 0 ? Size{s.h, s.w} : s;
+}
+
+// the transformed box which keeps the center of 'r'
+inline Rect transform(Rect r, Transform t) {
+    const Size size = transform(r.size, t);
+    const Point center = r.position + Vector{r.size.w / 2, r.size.h / 2};
+    return {center - Vector{size.w / 2, size.h / 2}, size};
+}
+
+// maps a point of a box of size 's' to the transformed box
+inline Point transform(Point p, Size s, Transform t) {
+    const auto value = static_cast<uint8_t>(t);
+    if ((value & 4U) != 0) {
+        p = {s.w - 1 - p.x, p.y};
+    }
+    switch (value & 3U) {
+        case 1: return {s.h - 1 - p.y, p.x};
+        case 2: return {s.w - 1 - p.x, s.h - 1 - p.y};
+        case 3: return {p.y, s.w - 1 - p.x};
+        default: return p;
+    }
+}
+
 inline struct nk_rect to_nk_rect(Rect rect) {
     return {
         static_cast<float>(rect.position.x),
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+namespace app {
+
+// SplitMix64 finalizer: a cheap, well-distributed 64-bit mixing function
+constexpr uint64_t splitMix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27U)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31U);
+}
+
+// Counter-based generator: the n-th value only depends on the seed, the stream and n,
+// so any part of a sequence can be generated independently and reproducibly
+class CounterRng {
+public:
+    constexpr CounterRng(uint64_t seed, uint64_t stream) : key{splitMix64(seed ^ splitMix64(stream))} {}
+
+    [[nodiscard]] constexpr uint64_t operator()(uint64_t counter) const { return splitMix64(key + counter * 0x9E3779B97F4A7C15ULL); }
+
+private:
+    uint64_t key;
+};
+
+}  // namespace app
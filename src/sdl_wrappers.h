@@ -63,6 +63,17 @@ namespace app::sdl {
             check(SDL_UpdateTexture(getRaw(), rect, pixels, pitch));
         }
 
+        // streaming textures: the pixels of the rectangle can be written until unlock(), what they contained is lost
+        [[nodiscard]] void* lock(const SDL_Rect* rect, int* pitch) const {
+            void* pixels = nullptr;
+            check(SDL_LockTexture(getRaw(), rect, &pixels, pitch));
+            return pixels;
+        }
+
+        void unlock() const {
+            SDL_UnlockTexture(getRaw());
+        }
+
     };
 
     class Surface : public SdlResource<SDL_Surface> {
@@ -104,6 +115,10 @@ namespace app::sdl {
             check(SDL_SetRenderTarget(getRaw(), texture));
         }
 
+        void setDrawBlendMode(SDL_BlendMode blendMode) const {
+            check(SDL_SetRenderDrawBlendMode(getRaw(), blendMode));
+        }
+
         void setDrawColor(const SDL_Color& color) const {
             check(SDL_SetRenderDrawColor(getRaw(), color.r, color.g, color.b, color.a));
         }
@@ -120,6 +135,14 @@ namespace app::sdl {
             check(SDL_RenderFillRect(getRaw(), rect));
         }
 
+        void fillRects(std::span<const SDL_Rect> rects) const {
+            check(SDL_RenderFillRects(getRaw(), rects.data(), static_cast<int>(rects.size())));
+        }
+
+        void drawRect(const SDL_Rect * rect) const {
+            check(SDL_RenderDrawRect(getRaw(), rect));
+        }
+
         void drawPoints(SDL_Point point) const {
             check(SDL_RenderDrawPoint(getRaw(), point.x, point.y));
         }
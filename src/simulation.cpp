@@ -1,16 +1,692 @@
 #include "simulation.h"
+#include "random.h"
+
 #include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
 
 namespace app {
 
-Simulation::Simulation(Size size, const Pattern& pattern) : m_size{size} {
+namespace {
+
+    constexpr uint64_t lowBits = 0x0101010101010101ULL;
+    constexpr uint64_t highBits = 0x8080808080808080ULL;
+
+    // SWAR comparison: each byte of the result is 1 if the matching byte of 'bytes' is below 'threshold' (0..256), 0 otherwise
+    uint64_t bytesBelow(uint64_t bytes, unsigned threshold) {
+        if (threshold > 0xFFU) {
+            return lowBits;
+        }
+        const uint64_t lowThreshold = lowBits * (threshold & 0x7FU);
+        const uint64_t lowBelow = ~(((bytes & ~highBits) | highBits) - lowThreshold) & highBits;
+        const uint64_t highBelow = ~bytes & highBits;
+        const uint64_t below = (threshold & 0x80U) != 0 ? (highBelow | lowBelow) : (highBelow & lowBelow);
+        return below >> 7U;
+    }
+
+    // Cells are 0 or 1: words of 8 cells are added as they are, each byte counting its column, then the bytes are
+    // summed with a multiplication (before any of them can reach 256, so after 31 words).
+    int64_t countAlive(const CellState* cells, int count) {
+        constexpr int wordsPerSum = 31;
+        int64_t alive = 0;
+        int i = 0;
+        while (i + 8 <= count) {
+            uint64_t columns = 0;
+            for (int n = 0; n < wordsPerSum && i + 8 <= count; n++, i += 8) {
+                uint64_t word = 0;
+                std::memcpy(&word, cells + i, 8);
+                columns += word;
+            }
+            alive += static_cast<int64_t>((columns * lowBits) >> 56U);
+        }
+        for (; i < count; i++) {
+            alive += cells[i];
+        }
+        return alive;
+    }
+
+    bool anyAlive(const CellState* cells, int count) {
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            uint64_t word = 0;
+            std::memcpy(&word, cells + i, 8);
+            if (word != 0) {
+                return true;
+            }
+        }
+        for (; i < count; i++) {
+            if (cells[i] == ALIVE) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 8 bits to 8 cells
+    constexpr std::array<uint64_t, 256> expandedBits = [] {
+        std::array<uint64_t, 256> table{};
+        for (unsigned byte = 0; byte < 256; byte++) {
+            for (unsigned bit = 0; bit < 8; bit++) {
+                table[byte] |= static_cast<uint64_t>((byte >> bit) & 1U) << (8 * bit);
+            }
+        }
+        return table;
+    }();
+
+    // 8 cells to 8 bits: the multiplication gathers the low bit of each byte into the top byte
+    uint64_t packedCells(uint64_t cells) {
+        return (cells * 0x0102040810204080ULL) >> 56U;
+    }
+
+    uint64_t zobristKey(int index) {
+        return splitMix64(static_cast<uint64_t>(index));
+    }
+
+    using Tile = std::array<CellState, Simulation::tileSize * Simulation::tileSize>;
+
+    enum TileVisibility : uint8_t {
+        Hidden,
+        PartlyVisible,
+        Visible
+    };
+
+    // XOR of two worlds 8 cells at a time, tile by tile: rowA/rowB(tile, x, y) give the cells of a row of a tile
+    template<typename Skip, typename RowA, typename RowB>
+    WorldDiff diffTiles(Size size, Skip skip, RowA rowA, RowB rowB) {
+        constexpr int tileSize = Simulation::tileSize;
+        const Size tiles{(size.w + tileSize - 1) / tileSize, (size.h + tileSize - 1) / tileSize};
+        WorldDiff result;
+        Point min{size.w, size.h};
+        Point max{-1, -1};
+        for (int tile = 0; tile < tiles.w * tiles.h; tile++) {
+            if (skip(tile)) {
+                continue;
+            }
+            const int x1 = (tile % tiles.w) * tileSize;
+            const int y1 = (tile / tiles.w) * tileSize;
+            const int width = std::min(tileSize, size.w - x1);
+            for (int y = y1; y < std::min(y1 + tileSize, size.h); y++) {
+                const CellState* a = rowA(tile, x1, y);
+                const CellState* b = rowB(tile, x1, y);
+                for (int x = 0; x < width; x += 8) {
+                    const auto count = static_cast<size_t>(std::min(8, width - x));
+                    uint64_t wordA = 0;
+                    uint64_t wordB = 0;
+                    std::memcpy(&wordA, a + x, count);
+                    std::memcpy(&wordB, b + x, count);
+                    for (uint64_t different = wordA ^ wordB; different != 0; different &= different - 1) {
+                        const Point p{x1 + x + std::countr_zero(different) / 8, y};
+                        result.cells.push_back(p);
+                        min = {std::min(min.x, p.x), std::min(min.y, p.y)};
+                        max = {std::max(max.x, p.x), std::max(max.y, p.y)};
+                    }
+                }
+            }
+        }
+        result.count = static_cast<int64_t>(result.cells.size());
+        if (result.count > 0) {
+            result.boundingBox = {min, {max.x - min.x + 1, max.y - min.y + 1}};
+        }
+        return result;
+    }
+
+} // anonymous namespace
+
+struct Snapshot::Data {
+    const Simulation* world = nullptr; // reset when the world is destroyed, the snapshot then owns all its tiles
+    const CellState* worldCells = nullptr;
+    Size size;
+    Size tiles;
+    int64_t generation = 0;
+    int64_t population = 0;
+    std::optional<uint64_t> hash; // unless it was being recomputed
+    std::vector<int> changeList;
+    std::vector<int> dirtyTiles;
+    std::vector<std::shared_ptr<const Tile>> tileCells; // nullptr while the tile is unchanged in the world
+    size_t ownedTiles = 0; // the tileCells which aren't nullptr
+
+    // cells from (x, y) to the end of the row of the tile (in world coordinates)
+    [[nodiscard]] const CellState* row(int tile, int x, int y) const {
+        const Tile* cells = tileCells[tile].get();
+        return cells != nullptr ? &(*cells)[(y % Simulation::tileSize) * Simulation::tileSize + x % Simulation::tileSize] : worldCells + y * size.w + x;
+    }
+
+    // true if the tile is known to be the same in both snapshots without looking at it
+    [[nodiscard]] bool sharesTile(const Data& other, int tile) const {
+        return tileCells[tile] == other.tileCells[tile] && (tileCells[tile] != nullptr || world == other.world);
+    }
+};
+
+Size Snapshot::size() const {
+    return data->size;
+}
+
+int64_t Snapshot::generation() const {
+    return data->generation;
+}
+
+int64_t Snapshot::population() const {
+    return data->population;
+}
+
+size_t Snapshot::memoryUsage() const {
+    return data->ownedTiles * sizeof(Tile) + data->changeList.size() * sizeof(int);
+}
+
+CellState Snapshot::get(int x, int y) const {
+    return *data->row((y / Simulation::tileSize) * data->tiles.w + x / Simulation::tileSize, x, y);
+}
+
+WorldDiff diff(const Snapshot& a, const Snapshot& b) {
+    if (!a.valid() || !b.valid() || a.size() != b.size()) {
+        throw std::invalid_argument("the snapshots don't have the same size");
+    }
+    const Snapshot::Data& dataA = *a.data;
+    const Snapshot::Data& dataB = *b.data;
+    return diffTiles(dataA.size,
+        [&](int tile) { return dataA.sharesTile(dataB, tile); },
+        [&](int tile, int x, int y) { return dataA.row(tile, x, y); },
+        [&](int tile, int x, int y) { return dataB.row(tile, x, y); });
+}
+
+Simulation::Simulation(Size size, const Pattern& pattern) : m_size{size},
+    m_tiles{(size.w + tileSize - 1) / tileSize, (size.h + tileSize - 1) / tileSize} {
     matrix.resize(size.w * size.h);
+    dirtyTiles.resize(m_tiles.w * m_tiles.h);
+    rowPopulation.resize(size.h);
+    m_tilePopulation.resize(m_tiles.w * m_tiles.h);
+    hashHistory.resize(maxDetectedPeriod);
+    sharedTiles.resize(m_tiles.w * m_tiles.h);
+    tileEpochs.resize(m_tiles.w * m_tiles.h);
+    viewportTiles.resize(m_tiles.w * m_tiles.h);
+    tileDeltaCounts.resize(m_tiles.w * m_tiles.h);
     init(pattern);
 }
 
+Simulation::~Simulation() {
+    // the snapshots which outlive the world take their remaining tiles with them
+    for (int tile = 0; tile < m_tiles.w * m_tiles.h; tile++) {
+        preserveTile(tile);
+    }
+    for (const auto& weak : snapshots) {
+        if (const auto data = weak.lock()) {
+            data->world = nullptr;
+            data->worldCells = nullptr;
+        }
+    }
+}
+
 void Simulation::set(int x, int y, CellState cellState) {
+    assert(x >= 0 && y >= 0 && x < m_size.w && y < m_size.h);
     updateChangeList(y * m_size.w + x, cellState);
-    matrix[y * m_size.w + x] = cellState;
+    if (matrix[y * m_size.w + x] != cellState) {
+        const int tile = tileOf(x, y);
+        preserveTile(tile);
+        matrix[y * m_size.w + x] = cellState;
+        m_hash ^= zobristKey(y * m_size.w + x);
+        countCell(x, y, tile, cellState);
+        trimBounds();
+        resetHistory();
+        m_revision++;
+        viewportCellsValid = false;
+    }
+}
+
+uint64_t Simulation::hash() const {
+    if (!hashValid) {
+        m_hash = 0;
+        for (int i = 0; i < m_size.w * m_size.h; i++) {
+            if (matrix[i] == ALIVE) {
+                m_hash ^= zobristKey(i);
+            }
+        }
+        hashValid = true;
+    }
+    return m_hash;
+}
+
+void Simulation::hashRegion(Rect region) {
+    // the keys of the region's cells are XORed out before the edit and in after it, unless rescanning the whole world
+    // when it's next needed costs about as much
+    if (!hashValid || static_cast<int64_t>(region.size.w) * region.size.h * 4 > static_cast<int64_t>(m_size.w) * m_size.h) {
+        hashValid = false;
+        return;
+    }
+    for (int y = region.position.y; y < region.position.y + region.size.h; y++) {
+        const int index = y * m_size.w;
+        int x = region.position.x;
+        for (; x + 8 <= region.position.x + region.size.w; x += 8) {
+            uint64_t word = 0;
+            std::memcpy(&word, &matrix[index + x], 8);
+            for (; word != 0; word &= word - 1) {
+                m_hash ^= zobristKey(index + x + std::countr_zero(word) / 8);
+            }
+        }
+        for (; x < region.position.x + region.size.w; x++) {
+            if (matrix[index + x] == ALIVE) {
+                m_hash ^= zobristKey(index + x);
+            }
+        }
+    }
+}
+
+void Simulation::recordHash() {
+    const uint64_t h = hash();
+    const auto found = hashGenerations.find(h);
+    if (found != hashGenerations.end()) {
+        m_period = static_cast<int>(m_generation - found->second);
+    } else {
+        m_period.reset();
+    }
+
+    // forget the hash that's now too old to be part of a detectable cycle
+    uint64_t& slot = hashHistory[m_generation % maxDetectedPeriod];
+    if (const auto old = hashGenerations.find(slot); old != hashGenerations.end() && old->second == m_generation - maxDetectedPeriod) {
+        hashGenerations.erase(old);
+    }
+    slot = h;
+    hashGenerations[h] = m_generation;
+}
+
+void Simulation::resetHistory() {
+    if (!hashGenerations.empty()) {
+        hashGenerations.clear();
+    }
+    m_period.reset();
+}
+
+Rect Simulation::boundingBox() const {
+    if (m_population == 0) {
+        return {};
+    }
+    return {boundsMin, {boundsMax.x - boundsMin.x + 1, boundsMax.y - boundsMin.y + 1}};
+}
+
+void Simulation::countCell(int x, int y, int tile, CellState state) {
+    const int delta = state == ALIVE ? 1 : -1;
+    rowPopulation[y] += delta;
+    m_tilePopulation[tile] += delta;
+    m_population += delta;
+    countBlocks(x, y, delta);
+    if (state == ALIVE) {
+        if (m_population == 1) {
+            boundsMin = boundsMax = {x, y};
+        } else {
+            boundsMin = {std::min(boundsMin.x, x), std::min(boundsMin.y, y)};
+            boundsMax = {std::max(boundsMax.x, x), std::max(boundsMax.y, y)};
+        }
+    }
+}
+
+void Simulation::countBlocks(int x, int y, int delta) {
+    for (int level = 1; level <= densityLevels(); level++) {
+        DensityLevel& density = m_density[level - 1];
+        uint16_t& block = density.blocks[(y >> level) * density.size.w + (x >> level)];
+        block = static_cast<uint16_t>(block + delta);
+    }
+}
+
+void Simulation::countRegion(Rect region, int sign) {
+    const int x2 = region.position.x + region.size.w;
+    for (int y = region.position.y; y < region.position.y + region.size.h; y++) {
+        const CellState* row = &matrix[y * m_size.w];
+        int rowCount = 0;
+        // one segment per tile (the cells of an empty tile don't need to be looked at to be taken out)
+        for (int x = region.position.x; x < x2; x = (x / tileSize + 1) * tileSize) {
+            int& tilePopulation = m_tilePopulation[(y / tileSize) * m_tiles.w + x / tileSize];
+            if (sign < 0 && tilePopulation == 0) {
+                continue;
+            }
+            const auto tileCount = static_cast<int>(countAlive(row + x, std::min(x2, (x / tileSize + 1) * tileSize) - x));
+            tilePopulation += sign * tileCount;
+            rowCount += tileCount;
+        }
+        rowPopulation[y] += sign * rowCount;
+        m_population += sign * rowCount;
+    }
+    staleDensity(region);
+}
+
+void Simulation::staleDensity(Rect region) {
+    if (!m_density.empty()) {
+        const int x2 = region.position.x + region.size.w;
+        const int tx2 = (x2 - 1) / tileSize;
+        const int ty2 = (region.position.y + region.size.h - 1) / tileSize;
+        for (int ty = region.position.y / tileSize; ty <= ty2; ty++) {
+            for (int tx = region.position.x / tileSize; tx <= tx2; tx++) {
+                staleDensityTiles[ty * m_tiles.w + tx] = 1;
+            }
+        }
+        densityValid = false;
+    }
+}
+
+void Simulation::countDensity(int tx, int ty) const {
+    const Rect rect = tileRect(tx, ty);
+    const bool empty = m_tilePopulation[ty * m_tiles.w + tx] == 0;
+    for (int level = 1; level <= densityLevels(); level++) {
+        DensityLevel& density = m_density[level - 1];
+        const int blocks = tileSize >> level;
+        for (int by = ty * blocks; by < (ty + 1) * blocks; by++) {
+            uint16_t* row = &density.blocks[by * density.size.w + tx * blocks];
+            std::fill_n(row, blocks, 0);
+            if (empty) {
+                continue;
+            }
+            if (level > 1) {
+                // from the 4 blocks of the level below
+                const DensityLevel& below = m_density[level - 2];
+                for (int bx = tx * blocks; bx < (tx + 1) * blocks; bx++) {
+                    row[bx - tx * blocks] = static_cast<uint16_t>(below.get(2 * bx, 2 * by) + below.get(2 * bx + 1, 2 * by) + below.get(2 * bx, 2 * by + 1) + below.get(2 * bx + 1, 2 * by + 1));
+                }
+            }
+        }
+        if (level == 1 && !empty) {
+            // (the blocks of the last tiles may stick out of the world)
+            for (int y = rect.position.y; y < rect.position.y + rect.size.h; y++) {
+                uint16_t* row = &density.blocks[(y >> 1) * density.size.w];
+                const CellState* cells = &matrix[y * m_size.w];
+                const int x2 = rect.position.x + rect.size.w;
+                for (int x = rect.position.x; x < x2; x += 2) {
+                    row[x >> 1] = static_cast<uint16_t>(row[x >> 1] + cells[x] + (x + 1 < x2 ? cells[x + 1] : 0));
+                }
+            }
+        }
+    }
+}
+
+Rect Simulation::tileRect(int tx, int ty) const {
+    return intersect({{tx * tileSize, ty * tileSize}, {tileSize, tileSize}}, {{0, 0}, m_size});
+}
+
+RegionStats Simulation::regionStats(Rect region) const {
+    region = intersect(region, {{0, 0}, m_size});
+    if (region.empty()) {
+        return {};
+    }
+
+    int64_t population = 0;
+    for (int ty = region.position.y / tileSize; ty <= (region.position.y + region.size.h - 1) / tileSize; ty++) {
+        for (int tx = region.position.x / tileSize; tx <= (region.position.x + region.size.w - 1) / tileSize; tx++) {
+            const int tilePopulation = m_tilePopulation[ty * m_tiles.w + tx];
+            const Rect tile = tileRect(tx, ty);
+            const Rect part = intersect(region, tile);
+            if (tilePopulation == 0 || (part.size.w == tile.size.w && part.size.h == tile.size.h)) {
+                population += tilePopulation;
+                continue;
+            }
+            for (int y = part.position.y; y < part.position.y + part.size.h; y++) {
+                population += countAlive(&matrix[y * m_size.w + part.position.x], part.size.w);
+            }
+        }
+    }
+    return {population, static_cast<double>(population) / (static_cast<double>(region.size.w) * region.size.h)};
+}
+
+bool Simulation::isEmpty(Rect region) const {
+    region = intersect(region, {{0, 0}, m_size});
+    for (int ty = region.position.y / tileSize; !region.empty() && ty <= (region.position.y + region.size.h - 1) / tileSize; ty++) {
+        for (int tx = region.position.x / tileSize; tx <= (region.position.x + region.size.w - 1) / tileSize; tx++) {
+            if (m_tilePopulation[ty * m_tiles.w + tx] == 0) {
+                continue;
+            }
+            const Rect part = intersect(region, tileRect(tx, ty));
+            for (int y = part.position.y; y < part.position.y + part.size.h; y++) {
+                if (anyAlive(&matrix[y * m_size.w + part.position.x], part.size.w)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<Rect> Simulation::occupiedTiles(Rect region) const {
+    std::vector<Rect> parts;
+    region = intersect(region, {{0, 0}, m_size});
+    for (int ty = region.position.y / tileSize; !region.empty() && ty <= (region.position.y + region.size.h - 1) / tileSize; ty++) {
+        for (int tx = region.position.x / tileSize; tx <= (region.position.x + region.size.w - 1) / tileSize; tx++) {
+            if (m_tilePopulation[ty * m_tiles.w + tx] != 0) {
+                parts.push_back(intersect(region, tileRect(tx, ty)));
+            }
+        }
+    }
+    return parts;
+}
+
+std::vector<Point> Simulation::aliveCells(Rect region) const {
+    std::vector<Point> cells;
+    region = intersect(region, {{0, 0}, m_size});
+    for (int ty = region.position.y / tileSize; !region.empty() && ty <= (region.position.y + region.size.h - 1) / tileSize; ty++) {
+        for (int tx = region.position.x / tileSize; tx <= (region.position.x + region.size.w - 1) / tileSize; tx++) {
+            if (m_tilePopulation[ty * m_tiles.w + tx] == 0) {
+                continue;
+            }
+            const Rect part = intersect(region, tileRect(tx, ty));
+            for (int y = part.position.y; y < part.position.y + part.size.h; y++) {
+                const CellState* row = &matrix[y * m_size.w];
+                for (int x = part.position.x; x < part.position.x + part.size.w; x++) {
+                    if (x + 8 <= part.position.x + part.size.w && !anyAlive(row + x, 8)) {
+                        x += 7;
+                    } else if (row[x] == ALIVE) {
+                        cells.push_back({x, y});
+                    }
+                }
+            }
+        }
+    }
+    return cells;
+}
+
+void Simulation::trimBounds() {
+    // births extend the bounds as they happen, deaths can only shrink them: move the sides inward to the first non-empty row/column
+    if (m_population == 0) {
+        return;
+    }
+    while (rowPopulation[boundsMin.y] == 0) {
+        boundsMin.y++;
+    }
+    while (rowPopulation[boundsMax.y] == 0) {
+        boundsMax.y--;
+    }
+    boundsMin.x = firstAliveColumn(boundsMin.x, 1);
+    boundsMax.x = firstAliveColumn(boundsMax.x, -1);
+}
+
+int Simulation::firstAliveColumn(int x, int step) const {
+    // within the rows of the bounds: the columns of tiles without live cells are skipped at once, the columns of the
+    // others are only looked at in those tiles
+    const int ty1 = boundsMin.y / tileSize;
+    const int ty2 = boundsMax.y / tileSize;
+    while (true) {
+        const int tx = x / tileSize;
+        bool emptyTiles = true;
+        for (int ty = ty1; emptyTiles && ty <= ty2; ty++) {
+            emptyTiles = m_tilePopulation[ty * m_tiles.w + tx] == 0;
+        }
+        if (emptyTiles) {
+            x = step > 0 ? (tx + 1) * tileSize : tx * tileSize - 1;
+            continue;
+        }
+        // (the tiles have live cells, so one of their columns is reached before leaving them)
+        for (;; x += step) {
+            for (int ty = ty1; ty <= ty2; ty++) {
+                if (m_tilePopulation[ty * m_tiles.w + tx] == 0) {
+                    continue;
+                }
+                for (int y = std::max(boundsMin.y, ty * tileSize); y <= std::min(boundsMax.y, (ty + 1) * tileSize - 1); y++) {
+                    if (matrix[y * m_size.w + x] == ALIVE) {
+                        return x;
+                    }
+                }
+            }
+        }
+    }
+}
+
+Rect Simulation::beginBulkEdit(Rect region) {
+    // the 2-cell border never evolves, so it's left untouched like in updateChangeList()
+    region = intersect(region, {{2, 2}, {m_size.w - 4, m_size.h - 4}});
+    if (!region.empty()) {
+        preserveTiles(region);
+        countRegion(region, -1);
+        hashRegion(region);
+    }
+    return region;
+}
+
+void Simulation::endBulkEdit(Rect region, bool counted) {
+    if (counted) {
+        staleDensity(region);
+    } else {
+        countRegion(region, 1);
+    }
+    hashRegion(region);
+
+    // the edit may have removed the cells defining the bounds as well as extended them
+    if (m_population > 0) {
+        boundsMin = {0, 0};
+        boundsMax = {m_size.w - 1, m_size.h - 1};
+        trimBounds();
+    }
+
+    resetHistory();
+    m_revision++;
+    viewportCellsValid = false;
+
+    markDirty(region);
+}
+
+void Simulation::fillRandom(Rect region, double density, uint64_t seed) {
+    region = beginBulkEdit(region);
+    if (region.empty()) {
+        return;
+    }
+
+    // Each random byte decides one cell: 8 cells are generated and written per 64-bit word. They're counted from the
+    // words too, added as they are (each byte counting its column) and summed with a multiplication once per tile.
+    const auto threshold = static_cast<unsigned>(std::clamp(density, 0., 1.) * 256);
+    for (int y = region.position.y; y < region.position.y + region.size.h; y++) {
+        const CounterRng rng{seed, static_cast<uint64_t>(y)};
+        CellState* row = &matrix[y * m_size.w + region.position.x];
+        int* tilePopulation = &m_tilePopulation[(y / tileSize) * m_tiles.w];
+        int rowCount = 0;
+        // (the words start from the region, the tiles are split where a word crosses their boundary)
+        int x = 0;
+        while (x < region.size.w) {
+            const int tile = (region.position.x + x) / tileSize;
+            const int tileEnd = std::min(region.size.w, (tile + 1) * tileSize - region.position.x);
+            uint64_t columns = 0;
+            for (; x < tileEnd; x += 8) {
+                const int cells = std::min(8, region.size.w - x);
+                uint64_t word = bytesBelow(rng(x / 8), threshold);
+                if (cells == 8) {
+                    std::memcpy(row + x, &word, 8);
+                } else {
+                    word &= (uint64_t{1} << (8U * cells)) - 1;
+                    for (int i = 0; i < cells; i++) {
+                        row[x + i] = static_cast<CellState>((word >> (8U * i)) & 0xFFU);
+                    }
+                }
+                if (x + 8 > tileEnd && tileEnd < region.size.w) {
+                    // the end of the word belongs to the next tile
+                    const unsigned inTile = 8U * static_cast<unsigned>(tileEnd - x);
+                    tilePopulation[tile + 1] += static_cast<int>((((word >> inTile) * lowBits) >> 56U));
+                    rowCount += static_cast<int>((((word >> inTile) * lowBits) >> 56U));
+                    word &= (uint64_t{1} << inTile) - 1;
+                }
+                columns += word;
+            }
+            const auto count = static_cast<int>((columns * lowBits) >> 56U);
+            tilePopulation[tile] += count;
+            rowCount += count;
+        }
+        rowPopulation[y] += rowCount;
+        m_population += rowCount;
+    }
+    endBulkEdit(region, true);
+}
+
+void Simulation::place(const Bitmap& bitmap, Point origin, Transform transform, PlaceMode mode) {
+    const Bitmap transformed = transform == Transform::Identity ? Bitmap{} : bitmap.transformed(transform);
+    const Bitmap& source = transform == Transform::Identity ? bitmap : transformed;
+    const Rect region = beginBulkEdit({origin, source.size()});
+    if (region.empty()) {
+        return;
+    }
+
+    // rows are expanded 8 bits at a time into 8 cells
+    for (int y = region.position.y; y < region.position.y + region.size.h; y++) {
+        CellState* row = &matrix[y * m_size.w];
+        const int sourceY = y - origin.y;
+        for (int x = region.position.x; x < region.position.x + region.size.w; x += 8) {
+            uint64_t cells = expandedBits[source.byteAt(x - origin.x, sourceY)];
+            const int count = std::min(8, region.position.x + region.size.w - x);
+            if (count == 8) {
+                if (mode == PlaceMode::Merge) {
+                    uint64_t current = 0;
+                    std::memcpy(&current, row + x, 8);
+                    cells |= current;
+                }
+                std::memcpy(row + x, &cells, 8);
+            } else {
+                for (int i = 0; i < count; i++, cells >>= 8U) {
+                    const auto cell = static_cast<CellState>(cells & 0xFFU);
+                    row[x + i] = mode == PlaceMode::Merge ? static_cast<CellState>(row[x + i] | cell) : cell;
+                }
+            }
+        }
+    }
+
+    endBulkEdit(region);
+}
+
+void Simulation::clear(Rect region) {
+    region = beginBulkEdit(region);
+    if (region.empty()) {
+        return;
+    }
+    for (int y = region.position.y; y < region.position.y + region.size.h; y++) {
+        std::memset(&matrix[y * m_size.w + region.position.x], DEAD, region.size.w);
+    }
+    endBulkEdit(region);
+}
+
+Bitmap Simulation::extract(Rect region) const {
+    region = intersect(region, {{0, 0}, m_size});
+    if (region.empty()) {
+        return {};
+    }
+
+    Bitmap bitmap{region.size};
+    for (int y = 0; y < region.size.h; y++) {
+        packCells(region.position.x, region.position.y + y, region.size.w, bitmap.row(y), 0);
+    }
+    return bitmap;
+}
+
+void Simulation::packCells(int x, int y, int count, std::span<uint64_t> bits, int firstBit) const {
+    // (firstBit is a multiple of 8: each byte of cells goes in a single word)
+    const CellState* row = &matrix[y * m_size.w + x];
+    for (int i = 0; i < count; i += 8) {
+        uint64_t cells = 0;
+        std::memcpy(&cells, row + i, static_cast<size_t>(std::min(8, count - i)));
+        bits[(firstBit + i) / 64] |= packedCells(cells) << ((firstBit + i) % 64);
+    }
+}
+
+void Simulation::markDirty(Rect region) {
+    for (int ty = region.position.y / tileSize; ty <= (region.position.y + region.size.h - 1) / tileSize; ty++) {
+        for (int tx = region.position.x / tileSize; tx <= (region.position.x + region.size.w - 1) / tileSize; tx++) {
+            const int tile = ty * m_tiles.w + tx;
+            if (dirtyTiles[tile] == 0) {
+                dirtyTiles[tile] = 1;
+                dirtyTileList.push_back(tile);
+            }
+        }
+    }
 }
 
 void Simulation::updateChangeList(int index, CellState cellState) {
@@ -25,27 +701,293 @@ void Simulation::updateChangeList(int index, CellState cellState) {
     }
 }
 
+void Simulation::reserveChangeList(size_t count) {
+    // The write list is about to get count keys in the order of another list's buckets: with fewer buckets than them,
+    // it would get them all in its first ones while it grows, until robin_hood gives up (map overflow).
+    size_t& reserved = changeListReserve[writeChangeList == &changeList ? 0 : 1];
+    if (count > reserved) {
+        reserved = std::max(count, writeChangeList->size());
+        writeChangeList->reserve(reserved);
+    }
+}
+
 void Simulation::nextStep() {
+    if (hashGenerations.empty()) {
+        // first step since the last edit
+        recordHash();
+    }
+
     std::swap(readChangeList, writeChangeList);
     writeChangeList->clear();
+    reserveChangeList(readChangeList->size());
     for (const int index : *readChangeList) {
         // (this often does the calculations more than once on the same cell, but it's still faster than preventing it with a set)
+        // Only the cells next to the border have neighbours on it, the others are updated without their coordinates.
+        const int y = index / m_size.w;
+        const int x = index - y * m_size.w;
+        if (x <= 2 || y <= 2 || x >= m_size.w - 3 || y >= m_size.h - 3) {
+            for (int i = -1; i <= 1; i++) {
+                for (int j = -1; j <= 1; j++) {
+                    updateChangeList(index + j + i * m_size.w, nextState(index + j + i * m_size.w));
+                }
+            }
+            continue;
+        }
         for (int i = -1; i <= 1; i++) {
             updateCell(index - 1 + i * m_size.w);
             updateCell(index + i * m_size.w);
             updateCell(index + 1 + i * m_size.w);
         }
     }
+    for (const int tile : dirtyTileList) {
+        updateTile(tile);
+        dirtyTiles[tile] = 0;
+    }
+    dirtyTileList.clear();
+
+    applyChanges();
+}
+
+void Simulation::advance(std::span<const uint32_t> toggles) {
+    if (hashGenerations.empty()) {
+        recordHash();
+    }
+
+    writeChangeList->clear();
+    reserveChangeList(toggles.size());
+    for (const uint32_t index : toggles) {
+        writeChangeList->insert(static_cast<int>(index));
+    }
+    for (const int tile : dirtyTileList) {
+        dirtyTiles[tile] = 0;
+    }
+    dirtyTileList.clear();
+
+    applyChanges();
+}
+
+void Simulation::applyChanges() {
+    std::vector<uint32_t>& delta = deltas[++m_deltaCount % deltaRingSize];
+    std::vector<uint32_t>& viewportDelta = viewportDeltas[m_deltaCount % deltaRingSize];
+    std::vector<uint32_t>& tileDelta = tileDeltas[m_deltaCount % deltaRingSize];
+    delta.resize(writeChangeList->size());
+    viewportDelta.clear();
+    tileDelta.clear();
+    uint32_t* next = delta.data();
+    uint64_t* const tileCounts = tileDeltaCounts.data();
+    const uint8_t* const visibility = viewportTiles.data();
+    const uint64_t count = m_deltaCount;
+    toggleCells(*writeChangeList, [&](int index, int x, int y, int tile, CellState state) {
+        *next++ = static_cast<uint32_t>(index);
+        if (tileCounts[tile] != count) {
+            tileCounts[tile] = count;
+            tileDelta.push_back(static_cast<uint32_t>(tile));
+        }
+        if (visibility[tile] == Visible || (visibility[tile] == PartlyVisible && m_viewport.contains({x, y}))) {
+            viewportDelta.push_back(static_cast<uint32_t>(index));
+            updateViewportCell(x, y, state);
+        }
+    });
+
+    m_generation++;
+    recordHash();
+
+    if (!observers.empty()) {
+        for (StepObserver* observer : observers) {
+            observer->onStep(*this, delta);
+        }
+    }
+}
+
+template<typename Cells, typename Toggled>
+void Simulation::toggleCells(const Cells& indices, Toggled toggled) {
+    // One division per cell, then the statistics are updated from locals: each cell written (a byte) could be any of
+    // them for the compiler, which would load and store them all again for every cell.
+    CellState* const cells = matrix.data();
+    int* const rows = rowPopulation.data();
+    int* const tiles = m_tilePopulation.data();
+    const uint8_t* const shared = sharedTiles.data();
+    const int width = m_size.w;
+    const int tilesWidth = m_tiles.w;
+    const bool density = !m_density.empty();
+    int64_t population = m_population;
+    uint64_t hash = m_hash;
+    Point min = boundsMin;
+    Point max = boundsMax;
+    for (const auto cell : indices) {
+        const auto index = static_cast<int>(cell);
+        const int y = index / width;
+        const int x = index - y * width;
+        const int tile = (y / tileSize) * tilesWidth + x / tileSize;
+        if (shared[tile] != 0) {
+            preserveTile(tile);
+        }
+        const CellState state = cells[index] == ALIVE ? DEAD : ALIVE;
+        cells[index] = state;
+        const int change = state == ALIVE ? 1 : -1;
+        rows[y] += change;
+        tiles[tile] += change;
+        population += change;
+        if (density) {
+            countBlocks(x, y, change);
+        }
+        if (state == ALIVE) {
+            if (population == 1) {
+                min = max = {x, y};
+            } else {
+                min = {std::min(min.x, x), std::min(min.y, y)};
+                max = {std::max(max.x, x), std::max(max.y, y)};
+            }
+        }
+        hash ^= zobristKey(index);
+        toggled(index, x, y, tile, state);
+    }
+    m_population = population;
+    m_hash = hash;
+    boundsMin = min;
+    boundsMax = max;
+    trimBounds();
+}
+
+void Simulation::setViewport(Rect region) {
+    m_viewport = intersect(region, {{0, 0}, m_size});
+    viewportCellsValid = false;
+    for (int ty = 0; ty < m_tiles.h; ty++) {
+        for (int tx = 0; tx < m_tiles.w; tx++) {
+            const Rect tile = tileRect(tx, ty);
+            const Rect part = intersect(m_viewport, tile);
+            viewportTiles[ty * m_tiles.w + tx] = part.empty() ? Hidden : (part.size == tile.size ? Visible : PartlyVisible);
+        }
+    }
+}
+
+bool Simulation::inViewport(int x, int y, int tile) const {
+    const uint8_t visibility = viewportTiles[tile];
+    return visibility == Visible || (visibility == PartlyVisible && m_viewport.contains({x, y}));
+}
+
+void Simulation::updateViewportCell(int x, int y, CellState state) {
+    if (viewportCellsValid) {
+        m_viewportCells.set(x - m_viewport.position.x, y - m_viewport.position.y, state == ALIVE);
+    }
+}
+
+const Bitmap& Simulation::viewportCells() const {
+    if (!viewportCellsValid) {
+        // only the occupied tiles are packed, from a byte boundary of the bitmap (the cells before it are packed again)
+        m_viewportCells = Bitmap{m_viewport.size};
+        for (const Rect& part : occupiedTiles(m_viewport)) {
+            const int first = (part.position.x - m_viewport.position.x) & ~7;
+            const int count = part.position.x + part.size.w - m_viewport.position.x - first;
+            for (int y = part.position.y; y < part.position.y + part.size.h; y++) {
+                packCells(m_viewport.position.x + first, y, count, m_viewportCells.row(y - m_viewport.position.y), first);
+            }
+        }
+        viewportCellsValid = true;
+    }
+    return m_viewportCells;
+}
+
+void Simulation::setDensityLevels(int levels) {
+    if (levels < 0 || levels > maxDensityLevel) {
+        throw std::invalid_argument("unsupported density level");
+    }
+    if (levels == densityLevels()) {
+        return;
+    }
+
+    // the levels cover whole tiles, then everything is counted on the first read
+    m_density = std::vector<DensityLevel>(levels);
+    for (int level = 1; level <= levels; level++) {
+        DensityLevel& density = m_density[level - 1];
+        density.size = {m_tiles.w * (tileSize >> level), m_tiles.h * (tileSize >> level)};
+        density.blocks.resize(static_cast<size_t>(density.size.w) * density.size.h);
+    }
+    staleDensityTiles.assign(levels == 0 ? 0 : m_tiles.w * m_tiles.h, 1);
+    densityValid = levels == 0;
+}
+
+const DensityLevel& Simulation::density(int level) const {
+    if (!densityValid) {
+        for (int tile = 0; tile < m_tiles.w * m_tiles.h; tile++) {
+            if (staleDensityTiles[tile] != 0) {
+                countDensity(tile % m_tiles.w, tile / m_tiles.w);
+                staleDensityTiles[tile] = 0;
+            }
+        }
+        densityValid = true;
+    }
+    return m_density[level - 1];
+}
+
+void Simulation::filterViewport(const std::vector<uint32_t>& delta, std::vector<uint32_t>& viewportDelta) const {
+    viewportDelta.clear();
+    for (const uint32_t index : delta) {
+        const int y = static_cast<int>(index) / m_size.w;
+        const int x = static_cast<int>(index) - y * m_size.w;
+        if (inViewport(x, y, tileOf(x, y))) {
+            viewportDelta.push_back(index);
+        }
+    }
+}
+
+void Simulation::listTile(int tile, std::vector<uint32_t>& tileDelta) {
+    if (tileDeltaCounts[tile] != m_deltaCount) {
+        tileDeltaCounts[tile] = m_deltaCount;
+        tileDelta.push_back(static_cast<uint32_t>(tile));
+    }
+}
+
+void Simulation::toggle(std::span<const uint32_t> cells) {
+    toggleCells(cells, [&](int /*index*/, int x, int y, int tile, CellState state) {
+        if (inViewport(x, y, tile)) {
+            updateViewportCell(x, y, state);
+        }
+    });
+}
+
+void Simulation::seek(int64_t generation, std::span<const uint32_t> lastChanges) {
+    // the cells changed by the last step are the ones to re-evaluate first, as if the step had just been run
+    writeChangeList->clear();
+    reserveChangeList(lastChanges.size());
+    for (const uint32_t index : lastChanges) {
+        writeChangeList->insert(static_cast<int>(index));
+    }
+    std::vector<uint32_t>& delta = deltas[++m_deltaCount % deltaRingSize];
+    delta.assign(lastChanges.begin(), lastChanges.end());
+    filterViewport(delta, viewportDeltas[m_deltaCount % deltaRingSize]);
+    std::vector<uint32_t>& tileDelta = tileDeltas[m_deltaCount % deltaRingSize];
+    tileDelta.clear();
+    for (const uint32_t index : lastChanges) {
+        const int y = static_cast<int>(index) / m_size.w;
+        listTile(tileOf(static_cast<int>(index) - y * m_size.w, y), tileDelta);
+    }
+    m_generation = generation;
+    resetHistory();
+}
 
-    lastUpdatedCells = std::make_shared<std::vector<Cell>>();
-    for (int p : *writeChangeList) {
-        CellState state = matrix[p] == ALIVE ? DEAD : ALIVE;
-        matrix[p] = state;
-        lastUpdatedCells->push_back({p % m_size.w, p / m_size.w, state});
+void Simulation::updateTile(int tile) {
+    // a tile edited in bulk also affects the cells right around it
+    const int tx = tile % m_tiles.w;
+    const int ty = tile / m_tiles.w;
+    const int x1 = std::max(2, tx * tileSize - 1);
+    const int y1 = std::max(2, ty * tileSize - 1);
+    const int x2 = std::min(m_size.w - 3, (tx + 1) * tileSize);
+    const int y2 = std::min(m_size.h - 3, (ty + 1) * tileSize);
+    for (int y = y1; y <= y2; y++) {
+        for (int index = y * m_size.w + x1; index <= y * m_size.w + x2; index++) {
+            updateCell(index);
+        }
     }
 }
 
 void Simulation::updateCell(const int index) {
+    if (nextState(index) != matrix[index]) {
+        writeChangeList->insert(index);
+    }
+}
+
+CellState Simulation::nextState(const int index) const {
     int nbAliveNeighbours = 0;
 
     size_t i = index - m_size.w;
@@ -65,16 +1007,155 @@ void Simulation::updateCell(const int index) {
     } else if (state == ALIVE && nbAliveNeighbours != 2) {
         state = DEAD; // death;
     }
+    return state;
+}
+
+Snapshot Simulation::snapshot() {
+    Snapshot snapshot;
+    snapshot.data = std::make_shared<Snapshot::Data>();
+    Snapshot::Data& data = *snapshot.data;
+    data.world = this;
+    data.worldCells = matrix.data();
+    data.size = m_size;
+    data.tiles = m_tiles;
+    data.generation = m_generation;
+    data.population = m_population;
+    if (hashValid) {
+        data.hash = m_hash;
+    }
+    data.changeList.assign(writeChangeList->begin(), writeChangeList->end());
+    data.dirtyTiles = dirtyTileList;
+    data.tileCells.resize(m_tiles.w * m_tiles.h);
 
-    updateChangeList(index, state);
+    std::erase_if(snapshots, [](const auto& weak) { return weak.expired(); });
+    snapshots.push_back(snapshot.data);
+    markTiles();
+    return snapshot;
+}
+
+uint64_t Simulation::markTiles() {
+    // (the next change of each tile goes through preserveTile())
+    std::fill(sharedTiles.begin(), sharedTiles.end(), 1);
+    return ++epoch;
+}
+
+WorldDiff Simulation::diff(const Snapshot& snapshot) const {
+    if (!snapshot.valid() || snapshot.size() != m_size) {
+        throw std::invalid_argument("the snapshot doesn't match the size of the world");
+    }
+    const Snapshot::Data& data = *snapshot.data;
+    return diffTiles(m_size,
+        [&](int tile) { return data.tileCells[tile] == nullptr && data.world == this; },
+        [&](int, int x, int y) { return &matrix[y * m_size.w + x]; },
+        [&](int tile, int x, int y) { return data.row(tile, x, y); });
+}
+
+void Simulation::restore(const Snapshot& snapshot) {
+    if (!snapshot.valid() || snapshot.size() != m_size) {
+        throw std::invalid_argument("the snapshot doesn't match the size of the world");
+    }
+    const Snapshot::Data& data = *snapshot.data;
+    restoreTiles(snapshot, [&](int tile) { return data.tileCells[tile] == nullptr && data.world == this; });
+}
+
+void Simulation::restore(const Snapshot& snapshot, uint64_t ownMark, uint64_t worldMark) {
+    if (!snapshot.valid() || snapshot.size() != m_size || snapshot.data->world == nullptr) {
+        throw std::invalid_argument("the snapshot doesn't match the size of the world, or its world is gone");
+    }
+    const Snapshot::Data& data = *snapshot.data;
+    restoreTiles(snapshot, [&](int tile) {
+        return data.tileCells[tile] == nullptr && !tileChangedSince(tile, ownMark) && !data.world->tileChangedSince(tile, worldMark);
+    });
+}
+
+template<typename Unchanged>
+void Simulation::restoreTiles(const Snapshot& snapshot, Unchanged unchanged) {
+    const Snapshot::Data& data = *snapshot.data;
+    for (int tile = 0; tile < m_tiles.w * m_tiles.h; tile++) {
+        if (unchanged(tile)) {
+            continue;
+        }
+
+        const Rect rect = tileRect(tile % m_tiles.w, tile / m_tiles.w);
+        bool same = true;
+        for (int y = rect.position.y; same && y < rect.position.y + rect.size.h; y++) {
+            same = std::memcmp(&matrix[y * m_size.w + rect.position.x], data.row(tile, rect.position.x, y), rect.size.w) == 0;
+        }
+        if (same) {
+            continue;
+        }
+
+        preserveTile(tile);
+        countRegion(rect, -1);
+        for (int y = rect.position.y; y < rect.position.y + rect.size.h; y++) {
+            std::memcpy(&matrix[y * m_size.w + rect.position.x], data.row(tile, rect.position.x, y), rect.size.w);
+        }
+        countRegion(rect, 1);
+        markDirty(rect);
+    }
+
+    // the cells which were about to change at the time of the snapshot
+    reserveChangeList(writeChangeList->size() + data.changeList.size());
+    for (const int index : data.changeList) {
+        writeChangeList->insert(index);
+    }
+    for (const int tile : data.dirtyTiles) {
+        markDirty(tileRect(tile % m_tiles.w, tile / m_tiles.w));
+    }
+
+    if (m_population > 0) {
+        boundsMin = {0, 0};
+        boundsMax = {m_size.w - 1, m_size.h - 1};
+        trimBounds();
+    }
+    m_generation = data.generation;
+    // (Zobrist keys only depend on the position: the snapshot's hash holds in any world of the same size)
+    hashValid = data.hash.has_value();
+    m_hash = data.hash.value_or(0);
+    resetHistory();
+    m_revision++;
+    viewportCellsValid = false;
+}
+
+void Simulation::preserveTile(int tile) {
+    if (sharedTiles[tile] == 0) {
+        return;
+    }
+    sharedTiles[tile] = 0;
+    tileEpochs[tile] = epoch;
+
+    // a single copy is shared by all the snapshots which didn't save this tile yet
+    std::shared_ptr<Tile> cells;
+    std::erase_if(snapshots, [](const auto& weak) { return weak.expired(); });
+    for (const auto& weak : snapshots) {
+        const auto data = weak.lock();
+        if (data == nullptr || data->tileCells[tile] != nullptr) {
+            continue;
+        }
+        if (cells == nullptr) {
+            cells = std::make_shared<Tile>();
+            const Rect rect = tileRect(tile % m_tiles.w, tile / m_tiles.w);
+            for (int y = 0; y < rect.size.h; y++) {
+                std::memcpy(&(*cells)[y * tileSize], &matrix[(rect.position.y + y) * m_size.w + rect.position.x], rect.size.w);
+            }
+        }
+        data->tileCells[tile] = cells;
+        data->ownedTiles++;
+    }
+}
+
+void Simulation::preserveTiles(Rect region) {
+    for (int ty = region.position.y / tileSize; ty <= (region.position.y + region.size.h - 1) / tileSize; ty++) {
+        for (int tx = region.position.x / tileSize; tx <= (region.position.x + region.size.w - 1) / tileSize; tx++) {
+            preserveTile(ty * m_tiles.w + tx);
+        }
+    }
 }
 
 void Simulation::init(const Pattern& pattern) {
     const int yOffset = (m_size.h - pattern.size().h) / 2;
     const int xOffset = (m_size.w - pattern.size().w) / 2;
-    for (const auto& cell : pattern.aliveCells()) {
-        set(cell.x + xOffset, cell.y + yOffset, CellState::ALIVE);
-    }
+    place(pattern.bitmap(), {xOffset, yOffset});
 }
 
 }  // namespace app
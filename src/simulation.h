@@ -2,11 +2,15 @@
 
 #include "../deps/robin_hood.h"
 
+#include "bitmap.h"
 #include "pattern.h"
 #include "primitives.h"
 
 #include <array>
 #include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
 #include <vector>
 
 namespace app {
@@ -16,10 +20,67 @@ enum CellState : uint8_t {
     ALIVE
 };
 
-struct Cell {
-    int x;
-    int y;
-    CellState state;
+enum class PlaceMode {
+    Merge,  // alive cells are added to the world
+    Replace // the whole rectangle is overwritten
+};
+
+struct RegionStats {
+    int64_t population{};
+    double occupancy{}; // fraction of the region's cells which are alive
+};
+
+class Simulation;
+
+// alive cells per block of 2^level x 2^level cells, the block (bx, by) starting at the cell (bx << level, by << level)
+struct DensityLevel {
+    Size size;
+    std::vector<uint16_t> blocks;
+
+    [[nodiscard]] int get(int bx, int by) const { return blocks[by * size.w + bx]; }
+};
+
+struct WorldDiff {
+    int64_t count{};
+    std::vector<Point> cells;
+    Rect boundingBox;
+};
+
+// The world at one generation. Tiles are shared with the live world and only copied when the world is about to modify
+// them, so taking a snapshot costs O(tiles) and its memory grows with what changed since.
+class Snapshot {
+public:
+    [[nodiscard]] bool valid() const { return data != nullptr; }
+    [[nodiscard]] Size size() const;
+    [[nodiscard]] int64_t generation() const;
+    [[nodiscard]] int64_t population() const;
+    [[nodiscard]] CellState get(int x, int y) const;
+    // memory owned by the snapshot (tiles copied from the world since it was taken)
+    [[nodiscard]] size_t memoryUsage() const;
+
+private:
+    friend class Simulation;
+    friend WorldDiff diff(const Snapshot& a, const Snapshot& b);
+    struct Data;
+    std::shared_ptr<Data> data;
+};
+
+// cells which differ between two snapshots of the same size (the tiles both still share aren't even looked at)
+[[nodiscard]] WorldDiff diff(const Snapshot& a, const Snapshot& b);
+
+// Analysis hooked to the step loop: called after each generation computed by nextStep(), with the indices (y * width + x)
+// of the cells it toggled. The simulation can be queried (regions, statistics...) but not modified.
+class StepObserver {
+public:
+    virtual void onStep(const Simulation& simulation, std::span<const uint32_t> toggles) = 0;
+
+protected:
+    StepObserver() = default;
+    StepObserver(const StepObserver& right) = default;
+    StepObserver& operator=(const StepObserver& right) = default;
+    StepObserver(StepObserver&& right) noexcept = default;
+    StepObserver& operator=(StepObserver&& right) noexcept = default;
+    ~StepObserver() = default;
 };
 
 class Simulation
@@ -27,37 +88,192 @@ class Simulation
 public:
     using TChangeList = robin_hood::unordered_set<int>;
 
+    static constexpr int tileSize = 64;
+    static constexpr int maxDetectedPeriod = 1024;
+    // more than the generations of a frame at the top speed (1024 ups at 45 fps: about 23), or every frame is redrawn
+    static constexpr int deltaRingSize = 32;
+    static constexpr int maxDensityLevel = 6; // the blocks of every level fit in the tiles
+
     explicit Simulation(Size size, const Pattern& pattern = {});
 
     [[nodiscard]] CellState get(int x, int y) const { return matrix[y * m_size.w + x]; }
     void set(int x, int y, CellState cellState);
+    void fillRandom(Rect region, double density, uint64_t seed);
+    void place(const Bitmap& bitmap, Point origin, Transform transform = Transform::Identity, PlaceMode mode = PlaceMode::Merge);
+    void clear(Rect region);
+    // the cells of the region (clipped to the world) packed into a bitmap
+    [[nodiscard]] Bitmap extract(Rect region) const;
     [[nodiscard]] Size size() const { return m_size; }
-    [[nodiscard]] std::shared_ptr<std::vector<Cell>> updatedCells() const { return lastUpdatedCells; }
+    [[nodiscard]] int64_t population() const { return m_population; }
+    [[nodiscard]] Rect boundingBox() const;
+
+    // region queries: whole tiles are answered from the per-tile populations, the rest is counted a word at a time
+    [[nodiscard]] RegionStats regionStats(Rect region) const;
+    [[nodiscard]] bool isEmpty(Rect region) const;
+    [[nodiscard]] std::vector<Point> aliveCells(Rect region) const;
+    // the parts of the region in tiles which have live cells
+    [[nodiscard]] std::vector<Rect> occupiedTiles(Rect region) const;
+    [[nodiscard]] Size tiles() const { return m_tiles; }
+    [[nodiscard]] int tilePopulation(int tx, int ty) const { return m_tilePopulation[ty * m_tiles.w + tx]; }
+
+    [[nodiscard]] int64_t generation() const { return m_generation; }
+    [[nodiscard]] uint64_t hash() const;
+    [[nodiscard]] std::optional<int> period() const { return m_period; }
+    // true when the next steps can't change anything until the world is edited
+    [[nodiscard]] bool frozen() const { return writeChangeList->empty() && dirtyTileList.empty(); }
+    // Each step produces a delta: the indices (y * width + x) of the cells it toggled (after a seek(), the step which
+    // produced the generation reached). Only the last deltaRingSize deltas are kept, their buffers are recycled.
+    [[nodiscard]] uint64_t deltaCount() const { return m_deltaCount; }
+    // n-th delta, for deltaCount() - deltaRingSize < n <= deltaCount()
+    [[nodiscard]] std::span<const uint32_t> delta(uint64_t n) const { return deltas[n % deltaRingSize]; }
+    [[nodiscard]] std::span<const uint32_t> toggles() const { return delta(m_deltaCount); }
+    // the tiles (ty * tiles().w + tx) with cells toggled by the n-th delta
+    [[nodiscard]] std::span<const uint32_t> tileDelta(uint64_t n) const { return tileDeltas[n % deltaRingSize]; }
+
+    // Subscribed viewport: each delta also comes filtered to the cells inside it, which are found by tile during the
+    // step. An empty viewport ends the subscription; deltas produced before a change keep the previous viewport.
+    void setViewport(Rect region);
+    [[nodiscard]] Rect viewport() const { return m_viewport; }
+    // the cells of the viewport (from its top left corner), kept up to date by the steps and rebuilt after an edit
+    [[nodiscard]] const Bitmap& viewportCells() const;
+    [[nodiscard]] std::span<const uint32_t> viewportDelta(uint64_t n) const { return viewportDeltas[n % deltaRingSize]; }
+
+    // Density pyramid: the alive cells per block for the levels 1 to densityLevels() (0 until it's asked for). Every
+    // toggle updates one block per level, the tiles changed by an edit are counted again when the pyramid is next read.
+    void setDensityLevels(int levels);
+    [[nodiscard]] int densityLevels() const { return static_cast<int>(m_density.size()); }
+    [[nodiscard]] const DensityLevel& density(int level) const;
 
     void nextStep();
+    // the next generation from the cells toggled by a step computed elsewhere (on a copy of the world), as if nextStep()
+    // had produced it but at the cost of the toggles only
+    void advance(std::span<const uint32_t> toggles);
+
+    // compile-time observer: anything with the onStep() of a StepObserver, called directly (and inlined) after the step
+    template<typename Observer>
+    void nextStep(Observer& observer) {
+        nextStep();
+        observer.onStep(*this, toggles());
+    }
+
+    // runtime observers (not owned), they cost nothing to the step loop while there are none
+    void addObserver(StepObserver* observer) { observers.push_back(observer); }
+    void removeObserver(StepObserver* observer) { std::erase(observers, observer); }
+
+    // incremented by every edit, i.e. every change which isn't a step
+    [[nodiscard]] uint64_t revision() const { return m_revision; }
+    // replay of recorded steps: toggling the cells changed by a step undoes it (or redoes it), then seek() sets the
+    // generation reached and the cells changed by the step which produced it (which become the last delta)
+    void toggle(std::span<const uint32_t> cells);
+    void seek(int64_t generation, std::span<const uint32_t> lastChanges);
+
+    [[nodiscard]] Snapshot snapshot();
+    // cells which differ between the world and a snapshot of the same size
+    [[nodiscard]] WorldDiff diff(const Snapshot& snapshot) const;
+    // the snapshot can come from any world of the same size
+    void restore(const Snapshot& snapshot);
+    // Tiles changed since a mark (every snapshot also starts a new epoch of them). A world which was a copy of the
+    // snapshot's world when both were marked only looks at the tiles either of them changed since to restore it.
+    uint64_t markTiles();
+    [[nodiscard]] bool tileChangedSince(int tile, uint64_t mark) const { return tileEpochs[tile] >= mark; }
+    void restore(const Snapshot& snapshot, uint64_t ownMark, uint64_t worldMark);
 
     Simulation(const Simulation& right) = delete;
     Simulation& operator=(const Simulation& right) = delete;
     Simulation(Simulation&& right) noexcept = delete;
     Simulation& operator=(Simulation&& right) noexcept = delete;
-    ~Simulation() = default;
+    ~Simulation();
 
 private:
     TChangeList changeList{};
     TChangeList changeList2{};
     TChangeList* writeChangeList = &changeList;
     TChangeList* readChangeList = &changeList2;
-    std::shared_ptr<std::vector<Cell>> lastUpdatedCells;
+    std::array<size_t, 2> changeListReserve{}; // of changeList and changeList2, which keep their buckets when cleared
+    std::array<std::vector<uint32_t>, deltaRingSize> deltas;
+    uint64_t m_deltaCount = 0;
+    std::array<std::vector<uint32_t>, deltaRingSize> tileDeltas;
+    std::vector<uint64_t> tileDeltaCounts; // last delta listing each tile
+    Rect m_viewport;
+    std::vector<uint8_t> viewportTiles; // TileVisibility of each tile
+    std::array<std::vector<uint32_t>, deltaRingSize> viewportDeltas;
+    mutable Bitmap m_viewportCells;
+    mutable bool viewportCellsValid = false;
+    mutable std::vector<DensityLevel> m_density; // level n at n - 1
+    mutable std::vector<uint8_t> staleDensityTiles;
+    mutable bool densityValid = true;
+    std::vector<StepObserver*> observers;
 
     Size m_size;
+    Size m_tiles;
 
     std::vector<CellState> matrix;
+    std::vector<uint8_t> dirtyTiles;
+    std::vector<int> dirtyTileList;
+
+    // incrementally maintained statistics
+    int64_t m_population = 0;
+    std::vector<int> rowPopulation; // (the columns of the bounds are found from the tiles)
+    std::vector<int> m_tilePopulation;
+    Point boundsMin;
+    Point boundsMax;
+
+    // Zobrist hash of the world (XOR of the keys of the alive cells) and recent history for cycle detection
+    int64_t m_generation = 0;
+    uint64_t m_revision = 0;
+    mutable uint64_t m_hash = 0;
+    mutable bool hashValid = true;
+    std::vector<uint64_t> hashHistory;
+    robin_hood::unordered_map<uint64_t, int64_t> hashGenerations;
+    std::optional<int> m_period;
+
+    // tiles which are still shared with at least one snapshot
+    std::vector<uint8_t> sharedTiles;
+    uint64_t epoch = 0;
+    std::vector<uint64_t> tileEpochs; // when each tile was last changed (only its first change of an epoch is seen)
+    std::vector<std::weak_ptr<Snapshot::Data>> snapshots;
 
     void init(const Pattern& pattern);
 
+    [[nodiscard]] CellState nextState(int index) const;
+    // a cell off the border
     void updateCell(int index);
+    void updateTile(int tile);
+    void markDirty(Rect region);
+    Rect beginBulkEdit(Rect region);
+    // counted: the cells of the region were already counted as they were written
+    void endBulkEdit(Rect region, bool counted = false);
+
+    [[nodiscard]] int tileOf(int x, int y) const { return (y / tileSize) * m_tiles.w + x / tileSize; }
+    // toggled(index, x, y, tile, state) is called after each cell
+    template<typename Cells, typename Toggled>
+    void toggleCells(const Cells& indices, Toggled toggled);
+    void applyChanges();
+    [[nodiscard]] bool inViewport(int x, int y, int tile) const;
+    void updateViewportCell(int x, int y, CellState state);
+    void packCells(int x, int y, int count, std::span<uint64_t> bits, int firstBit) const;
+    void filterViewport(const std::vector<uint32_t>& delta, std::vector<uint32_t>& viewportDelta) const;
+    void listTile(int tile, std::vector<uint32_t>& tileDelta);
+    void countCell(int x, int y, int tile, CellState state);
+    void countBlocks(int x, int y, int delta);
+    void countRegion(Rect region, int sign);
+    void staleDensity(Rect region);
+    void countDensity(int tx, int ty) const;
+    void trimBounds();
+    [[nodiscard]] int firstAliveColumn(int x, int step) const;
+    [[nodiscard]] Rect tileRect(int tx, int ty) const;
+
+    template<typename Unchanged>
+    void restoreTiles(const Snapshot& snapshot, Unchanged unchanged);
+    void preserveTile(int tile);
+    void preserveTiles(Rect region);
+
+    void hashRegion(Rect region);
+    void recordHash();
+    void resetHistory();
 
     void updateChangeList(int index, CellState state);
+    void reserveChangeList(size_t count);
 };
 
 }  // namespace app
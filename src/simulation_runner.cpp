@@ -0,0 +1,264 @@
+#include "simulation_runner.h"
+
+namespace app {
+
+EditCommand EditCommand::set(Point cell, CellState state) {
+    EditCommand command;
+    command.kind = Kind::Set;
+    command.position = cell;
+    command.state = state;
+    return command;
+}
+
+EditCommand EditCommand::place(const Bitmap& pattern, Point origin, Transform transform) {
+    EditCommand command;
+    command.kind = Kind::Place;
+    command.position = origin;
+    command.pattern = pattern;
+    command.transform = transform;
+    return command;
+}
+
+EditCommand EditCommand::clear(Rect region) {
+    EditCommand command;
+    command.kind = Kind::Clear;
+    command.region = region;
+    return command;
+}
+
+EditCommand EditCommand::fill(Rect region, double density, uint64_t seed) {
+    EditCommand command;
+    command.kind = Kind::Fill;
+    command.region = region;
+    command.density = density;
+    command.seed = seed;
+    return command;
+}
+
+EditCommand EditCommand::transformRegion(Rect region, Transform transform) {
+    EditCommand command;
+    command.kind = Kind::Transform;
+    command.region = region;
+    command.transform = transform;
+    return command;
+}
+
+void EditCommand::applyTo(Simulation& world) const {
+    switch (kind) {
+        case Kind::Set:
+            world.set(position.x, position.y, state);
+            break;
+        case Kind::Place:
+            world.place(pattern, position, transform);
+            break;
+        case Kind::Clear:
+            world.clear(region);
+            break;
+        case Kind::Fill:
+            world.fillRandom(region, density, seed);
+            break;
+        case Kind::Transform: {
+            const Bitmap cells = world.extract(region);
+            world.clear(region);
+            world.place(cells, app::transform(region, transform).position, transform);
+        } break;
+    }
+}
+
+SimulationRunner::SimulationRunner(Size size) : shadow{std::make_unique<Simulation>(size)}, worker{&SimulationRunner::run, this} {
+}
+
+SimulationRunner::~SimulationRunner() {
+    {
+        const std::lock_guard lock{mutex};
+        quit = true;
+        running = false;
+    }
+    // (the worker may be waiting for room in the queue, or for something to do)
+    notify();
+    wake.notify_one();
+    worker.join();
+}
+
+void SimulationRunner::start(Simulation& world) {
+    if (running && world.revision() == revision && world.generation() == generation) {
+        return;
+    }
+
+    // the world was edited or moved in its history: start over from a copy of it
+    std::unique_lock lock{mutex};
+    stopWorker(lock, world);
+    const Snapshot current = world.snapshot();
+    if (synced == &world) {
+        shadow->restore(current, shadowMark, worldMark);
+    } else {
+        shadow->restore(current);
+        synced = &world;
+    }
+    worldMark = world.markTiles();
+    shadowMark = shadow->markTiles();
+    revision = world.revision();
+    generation = world.generation();
+    running = true;
+    lock.unlock();
+    wake.notify_one();
+}
+
+void SimulationRunner::stop(Simulation& world) {
+    if (!running) {
+        return;
+    }
+    std::unique_lock lock{mutex};
+    stopWorker(lock, world);
+}
+
+void SimulationRunner::allow(int64_t generation) {
+    if (limit.exchange(generation) < generation) {
+        notify();
+    }
+}
+
+bool SimulationRunner::edit(const Simulation& world, const EditCommand& command) {
+    if (!running || world.revision() != revision || world.generation() != generation) {
+        return false;
+    }
+    EditCommand* slot = edits.back();
+    if (slot == nullptr) {
+        return false;
+    }
+
+    *slot = command;
+    edits.push();
+    queuedEdits++;
+    notify();
+    return true;
+}
+
+bool SimulationRunner::applyEdits(Simulation& world) {
+    if (!running || world.revision() != revision || world.generation() != generation) {
+        return false;
+    }
+
+    bool edited = false;
+    for (Frame* frame = frames.front(); frame != nullptr && frame->edit; frame = frames.front()) {
+        frame->edit->applyTo(world);
+        frames.pop();
+        queuedEdits--;
+        edited = true;
+    }
+    if (edited) {
+        revision = world.revision();
+        notify();
+    }
+    return edited;
+}
+
+bool SimulationRunner::step(Simulation& world) {
+    if (!running || world.revision() != revision || world.generation() != generation) {
+        return false;
+    }
+    Frame* frame = frames.front();
+    if (frame == nullptr || frame->edit) {
+        return false;
+    }
+
+    world.advance(frame->toggles);
+    frames.pop();
+    generation++;
+    // (room for the worker if the queue was full)
+    notify();
+    return true;
+}
+
+void SimulationRunner::notify() {
+    // (sequentially consistent, not only a release: either the worker sees the new signal before parking, or this sees
+    // it parked)
+    signal.fetch_add(1);
+    if (parked.load()) {
+        const std::lock_guard lock{signalMutex};
+        signalled.notify_one();
+    }
+}
+
+uint32_t SimulationRunner::signals() const {
+    return signal.load(std::memory_order_acquire);
+}
+
+void SimulationRunner::waitSignal(uint32_t seen) {
+    std::unique_lock lock{signalMutex};
+    parked.store(true);
+    signalled.wait(lock, [&] { return signal.load() != seen; });
+    parked.store(false, std::memory_order_relaxed);
+}
+
+void SimulationRunner::stopWorker(std::unique_lock<std::mutex>& lock, Simulation& world) {
+    running = false;
+    notify();
+
+    // the generations computed ahead are dropped, not the edits
+    const auto drain = [&] {
+        for (Frame* frame = frames.front(); frame != nullptr; frame = frames.front()) {
+            if (frame->edit) {
+                frame->edit->applyTo(world);
+            }
+            frames.pop();
+        }
+    };
+    drain();
+    idle.wait(lock, [this] { return !busy; });
+    drain();
+
+    // (the worker is idle: its end of the edit queue can be used from here)
+    for (EditCommand* command = edits.front(); command != nullptr; command = edits.front()) {
+        command->applyTo(world);
+        edits.pop();
+    }
+    queuedEdits = 0;
+}
+
+void SimulationRunner::run() {
+    std::unique_lock lock{mutex};
+    while (true) {
+        wake.wait(lock, [this] { return quit || running; });
+        if (quit) {
+            return;
+        }
+
+        busy = true;
+        lock.unlock();
+        // the edits queued when a generation is reached go before the next one (the later ones can't hold it back)
+        size_t pendingEdits = 0;
+        // (what's seen of the signal is loaded before checking that it's still running, so that no stop is missed)
+        for (uint32_t seen = signals(); running; seen = signals()) {
+            Frame* frame = frames.back();
+            if (frame == nullptr) {
+                // (the world signals each generation it takes)
+                waitSignal(seen);
+                continue;
+            }
+
+            EditCommand* command = edits.front();
+            if (command != nullptr && (pendingEdits > 0 || shadow->generation() >= limit)) {
+                command->applyTo(*shadow);
+                frame->toggles.clear();
+                frame->edit = std::move(*command);
+                edits.pop();
+                pendingEdits -= pendingEdits > 0 ? 1 : 0;
+            } else if (shadow->generation() < limit) {
+                shadow->nextStep();
+                frame->toggles.assign(shadow->toggles().begin(), shadow->toggles().end());
+                frame->edit.reset();
+                pendingEdits = edits.size();
+            } else {
+                waitSignal(seen);
+                continue;
+            }
+            frames.push();
+        }
+        lock.lock();
+        busy = false;
+        idle.notify_all();
+    }
+}
+
+}  // namespace app
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "bitmap.h"
+#include "primitives.h"
+#include "simulation.h"
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace app {
+
+// An edit of a running world: the runner applies it between two generations to its copy of the world, then the world
+// gets it at the same point.
+struct EditCommand {
+    enum class Kind : uint8_t {
+        Set,
+        Place,
+        Clear,
+        Fill,
+        Transform
+    };
+
+    Kind kind = Kind::Set;
+    Point position;                              // Set, Place (origin)
+    CellState state = ALIVE;                     // Set
+    Bitmap pattern;                              // Place
+    Transform transform = Transform::Identity;   // Place, Transform
+    Rect region;                                 // Clear, Fill, Transform
+    double density = 0;                          // Fill
+    uint64_t seed = 0;                           // Fill
+
+    static EditCommand set(Point cell, CellState state);
+    static EditCommand place(const Bitmap& pattern, Point origin, Transform transform);
+    static EditCommand clear(Rect region);
+    static EditCommand fill(Rect region, double density, uint64_t seed);
+    // the cells of the region, taken at the generation the edit is applied to, are transformed around its center
+    static EditCommand transformRegion(Rect region, Transform transform);
+
+    void applyTo(Simulation& world) const;
+};
+
+// Runs a world on a background thread, on a copy of it. The generations come back through a lock-free queue as the
+// lists of cells each step toggles, so the world only has to apply them: the rendering and the simulation no longer
+// share the time of a frame.
+class SimulationRunner {
+public:
+    static constexpr size_t queueSize = 64;
+    static constexpr size_t editQueueSize = 256;
+
+    explicit SimulationRunner(Size size);
+    ~SimulationRunner();
+
+    // starts (or keeps) running ahead of the world, from a copy of it if it was edited or moved since the last call (a
+    // runner follows a single world)
+    void start(Simulation& world);
+    // drops the generations computed ahead, the worker waits for the next start(); the edits still on their way are
+    // applied to the world
+    void stop(Simulation& world);
+    // the worker doesn't compute past this generation (so that the edits don't wait behind the ones it computed ahead)
+    void allow(int64_t generation);
+
+    // queues an edit for the generation the worker is at, returns false if the world must be edited directly instead
+    bool edit(const Simulation& world, const EditCommand& command);
+    // applies the edits the worker has reached, returns true if there were any
+    bool applyEdits(Simulation& world);
+    // some edits haven't reached the world yet
+    [[nodiscard]] bool editsPending() const { return queuedEdits > 0; }
+    // moves the world one generation forward if the worker has computed it (and nothing was edited before that),
+    // returns false otherwise
+    bool step(Simulation& world);
+
+    SimulationRunner(const SimulationRunner& right) = delete;
+    SimulationRunner& operator=(const SimulationRunner& right) = delete;
+    SimulationRunner(SimulationRunner&& right) noexcept = delete;
+    SimulationRunner& operator=(SimulationRunner&& right) noexcept = delete;
+
+private:
+    struct Frame {
+        std::vector<uint32_t> toggles;
+        std::optional<EditCommand> edit; // applied instead of a step
+    };
+
+    std::unique_ptr<Simulation> shadow; // only touched by the worker while running
+    SpscQueue<Frame, queueSize> frames;
+    SpscQueue<EditCommand, editQueueSize> edits;
+    std::atomic<bool> running = false;
+    std::atomic<int64_t> limit = 0;
+    // bumped to wake the worker when it's waiting for edits, room in the queue or a higher limit (the mutex is only taken
+    // to park it, or to wake it up once parked)
+    std::atomic<uint32_t> signal = 0;
+    std::atomic<bool> parked = false;
+    std::mutex signalMutex;
+    std::condition_variable signalled;
+    // starting and stopping the worker
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    bool busy = false;
+    bool quit = false;
+    uint64_t revision = 0;   // of the world the queue applies to
+    int64_t generation = 0;  // of the world, the first queued step starts from there
+    // the world the copy was last made from, and the marks of both worlds then (restarting only looks at the tiles
+    // either changed since)
+    const Simulation* synced = nullptr;
+    uint64_t worldMark = 0;
+    uint64_t shadowMark = 0;
+    size_t queuedEdits = 0;  // not applied to the world yet
+    std::thread worker;
+
+    void run();
+    void notify();
+    [[nodiscard]] uint32_t signals() const;
+    void waitSignal(uint32_t seen);
+    void stopWorker(std::unique_lock<std::mutex>& lock, Simulation& world);
+};
+
+}  // namespace app
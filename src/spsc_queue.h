@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace app {
+
+// Lock-free queue between one producer thread and one consumer thread. The slots are reused: the producer fills the
+// next free one in place (a vector keeps its buffer from one use to the next) then publishes it with push(). It never
+// blocks: waiting for room or for something to read is up to the user.
+template<typename T, size_t capacity>
+class SpscQueue {
+    static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0, "the capacity must be a power of 2");
+
+public:
+    // producer: the slot to fill before push(), nullptr while the queue is full
+    [[nodiscard]] T* back() {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        return t - head.load(std::memory_order_acquire) == capacity ? nullptr : &slots[t % capacity];
+    }
+    void push() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // consumer: the oldest published slot, nullptr while the queue is empty
+    [[nodiscard]] T* front() {
+        const size_t h = head.load(std::memory_order_relaxed);
+        return h == tail.load(std::memory_order_acquire) ? nullptr : &slots[h % capacity];
+    }
+    void pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    // consumer: the slots published and not popped yet (more may have been published since)
+    [[nodiscard]] size_t size() const {
+        const size_t h = head.load(std::memory_order_relaxed);
+        return tail.load(std::memory_order_acquire) - h;
+    }
+    // consumer: drops everything published so far
+    void clear() { head.store(tail.load(std::memory_order_acquire), std::memory_order_release); }
+
+private:
+    std::array<T, capacity> slots{};
+    alignas(64) std::atomic<size_t> head{0}; // next slot to read, only written by the consumer
+    alignas(64) std::atomic<size_t> tail{0}; // next slot to write, only written by the producer
+};
+
+}  // namespace app